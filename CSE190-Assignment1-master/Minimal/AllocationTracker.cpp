@@ -0,0 +1,149 @@
+#include "AllocationTracker.h"
+
+#include <cstdlib>
+#include <new>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace
+{
+    // plain thread_locals without constructors, operator new may run before anything is initialized
+    thread_local uint64_t allocationCount = 0;
+    thread_local int exemptDepth = 0;
+
+    void* allocate(size_t size) {
+        if (exemptDepth == 0)
+            allocationCount++;
+        return std::malloc(size ? size : 1);
+    }
+
+#ifdef __cpp_aligned_new
+    void* allocateAligned(size_t size, std::align_val_t alignment) {
+        if (exemptDepth == 0)
+            allocationCount++;
+#ifdef _MSC_VER
+        return _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+        void* p = nullptr;
+        return posix_memalign(&p, (size_t)alignment, size ? size : 1) == 0 ? p : nullptr;
+#endif
+    }
+
+    void freeAligned(void* p) {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+#endif
+}
+
+namespace alloc
+{
+    uint64_t threadCount() {
+        return allocationCount;
+    }
+
+    Exempt::Exempt() {
+        exemptDepth++;
+    }
+
+    Exempt::~Exempt() {
+        exemptDepth--;
+    }
+}
+
+// replacements for the global allocation functions
+
+void* operator new(size_t size) {
+    void* p = allocate(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+#ifdef __cpp_aligned_new
+// the aligned overloads, for types declared with an alignment above the default (C++17);
+// counted like the rest, and freed the way their platform allocates them
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* p = allocateAligned(size, alignment);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    freeAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    freeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    freeAligned(p);
+}
+#endif
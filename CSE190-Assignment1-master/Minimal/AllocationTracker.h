@@ -0,0 +1,37 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <cstdint>
+
+/* Counts general heap allocations (every global operator new in this module) per thread,
+   so code that is supposed to run without touching the heap, like a steady-state frame,
+   can check that it does. Allocations inside the GL driver or the Oculus runtime come from
+   their own heaps and are not seen here. */
+namespace alloc
+{
+    // allocations made by the calling thread since it started, not counting Exempt scopes
+    uint64_t threadCount();
+
+    // counts the calling thread's allocations from construction on
+    class Guard {
+    public:
+        Guard() : start(threadCount()) {}
+        uint64_t allocations() const { return threadCount() - start; }
+
+    private:
+        uint64_t start;
+    };
+
+    // allocations on the calling thread are not counted while one of these is alive,
+    // for things the user asked for in the middle of a frame (dumping a report...)
+    class Exempt {
+    public:
+        Exempt();
+        ~Exempt();
+
+        Exempt(const Exempt&) = delete;
+        Exempt& operator=(const Exempt&) = delete;
+    };
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "Arena.h"
+
+#include <algorithm>
+
+Arena::Arena(size_t firstBlock) : nextBlockSize(std::max<size_t>(firstBlock, 256)) {
+}
+
+Arena::~Arena() {
+    for (Block& block : blocks)
+        delete[] block.data;
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    if (!blocks.empty()) {
+        Block& block = blocks.back();
+        size_t offset = ((uintptr_t)(block.data + block.used) + alignment - 1) / alignment * alignment - (uintptr_t)block.data;
+        if (offset + bytes <= block.size) {
+            block.used = offset + bytes;
+            return block.data + offset;
+        }
+    }
+
+    // doesn't fit: a new block, growing so a badly sized arena still needs few of them
+    Block block;
+    block.size = std::max(nextBlockSize, bytes + alignment);
+    block.data = new uint8_t[block.size];
+    size_t offset = ((uintptr_t)block.data + alignment - 1) / alignment * alignment - (uintptr_t)block.data;
+    block.used = offset + bytes;
+    blocks.push_back(block);
+    nextBlockSize = block.size * 2;
+    return block.data + offset;
+}
+
+void Arena::reset() {
+    if (blocks.size() > 1) {
+        // the last round needed several blocks: next time one the size of all of them
+        size_t total = 0;
+        for (Block& block : blocks) {
+            total += block.size;
+            delete[] block.data;
+        }
+        blocks.resize(1);
+        blocks[0].data = new uint8_t[total];
+        blocks[0].size = total;
+        nextBlockSize = total * 2;
+    }
+    if (!blocks.empty())
+        blocks[0].used = 0;
+}
+
+size_t Arena::bytesUsed() const {
+    size_t used = 0;
+    for (const Block& block : blocks)
+        used += block.used;
+    return used;
+}
+
+size_t Arena::bytesReserved() const {
+    size_t reserved = 0;
+    for (const Block& block : blocks)
+        reserved += block.size;
+    return reserved;
+}
@@ -0,0 +1,49 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/* Arena - bump allocator for data that lives and dies together, like everything a model
+   load produces before it reaches the GPU. Memory comes in large blocks and is handed back
+   all at once by reset() or the destructor; single allocations are never freed and no
+   constructors or destructors run, so only plain data belongs in here. */
+class Arena {
+public:
+    // the first block is at least firstBlock bytes; size it to the whole job and it is the only one
+    explicit Arena(size_t firstBlock = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T* allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without running destructors");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // frees everything at once; the memory is kept as a single block as big as all blocks
+    // together, so an arena reused for the same job stops allocating after the first round
+    void reset();
+
+    size_t bytesUsed() const;
+    // what the blocks take on the heap, used or not
+    size_t bytesReserved() const;
+    size_t blockCount() const { return blocks.size(); }
+
+private:
+    struct Block {
+        uint8_t* data;
+        size_t size, used;
+    };
+
+    std::vector<Block> blocks;
+    size_t nextBlockSize;
+};
+
+#endif
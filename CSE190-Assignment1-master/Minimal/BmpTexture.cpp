@@ -0,0 +1,88 @@
+#include "BmpTexture.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    const size_t FILE_HEADER_BYTES = 14;
+    const size_t INFO_HEADER_BYTES = 40; // BITMAPINFOHEADER, later versions only append to it
+    const uint32_t BI_RGB = 0;
+
+    uint16_t read16(const uint8_t* p) {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    uint32_t read32(const uint8_t* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+}
+
+namespace bmp
+{
+    bool isBmp(const std::string& path) {
+        if (path.size() < 4)
+            return false;
+        std::string ext = path.substr(path.size() - 4);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return ext == ".bmp";
+    }
+
+    bool uploadMapped(const std::string& path, bool srgb, int& width, int& height, GLenum& internalFormat) {
+        MappedFile file(path);
+        if (!file.valid() || file.size() < FILE_HEADER_BYTES + INFO_HEADER_BYTES)
+            return false;
+        const uint8_t* p = file.data();
+        if (p[0] != 'B' || p[1] != 'M')
+            return false;
+
+        uint32_t pixelOffset = read32(p + 10);
+        uint32_t infoSize = read32(p + 14);
+        int32_t w = (int32_t)read32(p + 18);
+        int32_t h = (int32_t)read32(p + 22);
+        uint16_t bitCount = read16(p + 28);
+        uint32_t compression = read32(p + 30);
+        if (infoSize < INFO_HEADER_BYTES || compression != BI_RGB || (bitCount != 24 && bitCount != 32) || w <= 0 || h == 0)
+            return false;
+
+        // positive heights are stored bottom row first
+        bool bottomUp = h > 0;
+        width = w;
+        height = bottomUp ? h : -h;
+
+        // rows are padded to 4 bytes, which is exactly GL's default unpack alignment
+        size_t stride = ((size_t)width * (bitCount / 8) + 3) & ~(size_t)3;
+        if (pixelOffset + stride * height > file.size())
+            return false;
+        const uint8_t* pixels = p + pixelOffset;
+
+        // the fourth byte of a 32 bit BI_RGB bitmap is unused, so both end up as RGB
+        GLenum format = bitCount == 24 ? GL_BGR : GL_BGRA;
+        internalFormat = srgb ? GL_SRGB8 : GL_RGB8;
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        if (!bottomUp) {
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        }
+        else {
+            // stbi_load hands images over top row first and the model UVs expect that,
+            // so flip by uploading each mapped row into its mirrored texture row
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+            for (int row = 0; row < height; row++)
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, height - 1 - row, width, 1, format, GL_UNSIGNED_BYTE, pixels + stride * row);
+        }
+
+        // the smaller levels come out of the mapping too, filtered on the worker threads.
+        // Channel order doesn't matter to the filter, they stay BGR(A)
+        mip::Image image(pixels, width, height, bitCount / 8);
+        image.stride = stride;
+        image.bottomUp = bottomUp;
+        mip::Chain chain = mip::generate(image, srgb, &JobSystem::instance(), false);
+        mip::upload(chain, internalFormat, format, 1);
+        return true;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef BMP_TEXTURE_H
+#define BMP_TEXTURE_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+namespace bmp
+{
+    // true for paths ending in .bmp, whatever the case
+    bool isBmp(const std::string& path);
+
+    // Zero copy fast path for uncompressed 24 / 32 bit BMPs: the file is memory mapped and
+    // level 0 of the currently bound GL_TEXTURE_2D is uploaded straight out of the mapping
+    // as GL_BGR(A); the rest of the chain is built from the mapping by mip::generate (in linear
+    // light and stored as GL_SRGB8 when srgb is set). Returns false without touching GL for
+    // anything else (RLE, palettes...).
+    bool uploadMapped(const std::string& path, bool srgb, int& width, int& height, GLenum& internalFormat);
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "DeletionQueue.h"
+
+DeletionQueue& DeletionQueue::instance() {
+    static DeletionQueue queue;
+    return queue;
+}
+
+void DeletionQueue::defer(ResourceKind kind, GLuint id) {
+    if (id == 0)
+        return;
+    for (Listener& listener : listeners)
+        listener(kind, id);
+    current.push_back(std::make_pair(kind, id));
+}
+
+void DeletionQueue::endFrame() {
+    if (!current.empty()) {
+        Batch batch;
+        batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        batch.objects.swap(current);
+        batches.push_back(std::move(batch));
+    }
+
+    // batches are fenced in order, the first one still in flight ends the search
+    while (!batches.empty()) {
+        GLenum status = glClientWaitSync(batches.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(batches.front().fence);
+        destroy(batches.front().objects);
+        batches.pop_front();
+    }
+}
+
+void DeletionQueue::flush() {
+    glFinish();
+    for (Batch& batch : batches) {
+        glDeleteSync(batch.fence);
+        destroy(batch.objects);
+    }
+    batches.clear();
+    destroy(current);
+    current.clear();
+}
+
+size_t DeletionQueue::pending() const {
+    size_t count = current.size();
+    for (const Batch& batch : batches)
+        count += batch.objects.size();
+    return count;
+}
+
+void DeletionQueue::destroy(const std::vector<Object>& objects) {
+    ResourceRegistry& registry = ResourceRegistry::instance();
+    for (const Object& object : objects) {
+        deleteGlObject(object.first, object.second);
+        registry.release(object.first, object.second);
+    }
+}
+
+GLuint createGlObject(ResourceKind kind) {
+    GLuint id = 0;
+    switch (kind) {
+    case ResourceKind::Buffer:       glGenBuffers(1, &id); break;
+    case ResourceKind::VertexArray:  glGenVertexArrays(1, &id); break;
+    case ResourceKind::Texture:      glGenTextures(1, &id); break;
+    case ResourceKind::Renderbuffer: glGenRenderbuffers(1, &id); break;
+    case ResourceKind::Framebuffer:  glGenFramebuffers(1, &id); break;
+    case ResourceKind::Program:      id = glCreateProgram(); break;
+    case ResourceKind::Query:        glGenQueries(1, &id); break;
+    default: break;
+    }
+    return id;
+}
+
+void deleteGlObject(ResourceKind kind, GLuint id) {
+    switch (kind) {
+    case ResourceKind::Buffer:       glDeleteBuffers(1, &id); break;
+    case ResourceKind::VertexArray:  glDeleteVertexArrays(1, &id); break;
+    case ResourceKind::Texture:      glDeleteTextures(1, &id); break;
+    case ResourceKind::Renderbuffer: glDeleteRenderbuffers(1, &id); break;
+    case ResourceKind::Framebuffer:  glDeleteFramebuffers(1, &id); break;
+    case ResourceKind::Program:      glDeleteProgram(id); break;
+    case ResourceKind::Query:        glDeleteQueries(1, &id); break;
+    default: break;
+    }
+}
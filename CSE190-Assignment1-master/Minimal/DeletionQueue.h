@@ -0,0 +1,57 @@
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include "ResourceRegistry.h"
+
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/* DeletionQueue - GL objects are not deleted when their owner lets go of them but at the
+   end of the frame, behind a fence, and only deleted for real once the GPU has passed it.
+   Frames still in flight can keep reading buffers and textures the CPU side already
+   dropped, including through bindless handles and persistent mappings the driver can't
+   track, and deleting never stalls. GlHandle feeds it. */
+class DeletionQueue {
+public:
+    typedef std::function<void(ResourceKind kind, GLuint id)> Listener;
+
+    static DeletionQueue& instance();
+
+    // queues id for deletion after everything submitted up to the end of this frame
+    void defer(ResourceKind kind, GLuint id);
+
+    // fences the objects deferred this frame and deletes those whose fence has passed
+    void endFrame();
+
+    // waits for the GPU and deletes everything queued, for shutdown (needs the context)
+    void flush();
+
+    // called as soon as an object is deferred, so caches keyed by GL name drop it right away
+    void addListener(Listener listener) { listeners.push_back(listener); }
+
+    size_t pending() const;
+
+private:
+    typedef std::pair<ResourceKind, GLuint> Object;
+
+    struct Batch {
+        GLsync fence;
+        std::vector<Object> objects;
+    };
+
+    DeletionQueue() {}
+
+    void destroy(const std::vector<Object>& objects);
+
+    std::vector<Object> current;
+    std::deque<Batch> batches;
+    std::vector<Listener> listeners;
+};
+
+// glGen* / glCreate* and glDelete* for one object of the given kind
+GLuint createGlObject(ResourceKind kind);
+void deleteGlObject(ResourceKind kind, GLuint id);
+
+#endif
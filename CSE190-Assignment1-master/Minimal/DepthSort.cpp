@@ -0,0 +1,56 @@
+#include "DepthSort.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace depthsort
+{
+    void frontToBack(const glm::mat4* transforms, size_t count, const glm::vec3& eye, const glm::vec3& forward,
+                     FrameAllocator& frame, uint32_t* order) {
+        if (count == 0)
+            return;
+        float* depths = frame.allocate<float>(count);
+        float nearest = FLT_MAX, farthest = -FLT_MAX;
+        for (size_t i = 0; i < count; i++) {
+            depths[i] = glm::dot(glm::vec3(transforms[i][3]) - eye, forward);
+            nearest = std::min(nearest, depths[i]);
+            farthest = std::max(farthest, depths[i]);
+        }
+
+        uint16_t* keys = frame.allocate<uint16_t>(count);
+        uint16_t* tempKeys = frame.allocate<uint16_t>(count);
+        uint32_t* tempOrder = frame.allocate<uint32_t>(count);
+        float scale = farthest > nearest ? 65535.0f / (farthest - nearest) : 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            keys[i] = (uint16_t)((depths[i] - nearest) * scale);
+            order[i] = (uint32_t)i;
+        }
+        radixSort16(keys, order, tempKeys, tempOrder, count);
+    }
+
+    void radixSort16(uint16_t* keys, uint32_t* values, uint16_t* tempKeys, uint32_t* tempValues, size_t count) {
+        // least significant byte first; after the second pass the data is back in keys / values
+        uint16_t* fromKeys = keys;
+        uint32_t* fromValues = values;
+        uint16_t* toKeys = tempKeys;
+        uint32_t* toValues = tempValues;
+        for (int shift = 0; shift < 16; shift += 8) {
+            size_t offsets[256] = {};
+            for (size_t i = 0; i < count; i++)
+                offsets[(fromKeys[i] >> shift) & 0xff]++;
+            size_t total = 0;
+            for (int digit = 0; digit < 256; digit++) {
+                size_t n = offsets[digit];
+                offsets[digit] = total;
+                total += n;
+            }
+            for (size_t i = 0; i < count; i++) {
+                size_t to = offsets[(fromKeys[i] >> shift) & 0xff]++;
+                toKeys[to] = fromKeys[i];
+                toValues[to] = fromValues[i];
+            }
+            std::swap(fromKeys, toKeys);
+            std::swap(fromValues, toValues);
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef DEPTH_SORT_H
+#define DEPTH_SORT_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameAllocator.h"
+
+/* DepthSort - draw order for opaque instances, nearest first, so early depth testing
+   rejects the fragments of whatever is behind them before they are shaded. Depths along
+   the view direction are quantized to 16 bits over the range the instances span and
+   put in order with two 8-bit radix passes: linear time, no comparisons, and the order of
+   instances at the same depth is kept. */
+namespace depthsort
+{
+    // order[i] is the index of the i-th nearest of count instances to eye looking along
+    // forward, measured at each transform's origin; scratch comes from frame
+    void frontToBack(const glm::mat4* transforms, size_t count, const glm::vec3& eye, const glm::vec3& forward,
+                     FrameAllocator& frame, uint32_t* order);
+
+    // stable sort of values by 16-bit keys, both arrays end up sorted; tempKeys and
+    // tempValues need count entries each
+    void radixSort16(uint16_t* keys, uint32_t* values, uint16_t* tempKeys, uint32_t* tempValues, size_t count);
+}
+
+#endif
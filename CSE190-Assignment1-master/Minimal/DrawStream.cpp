@@ -0,0 +1,80 @@
+#include "DrawStream.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+void DrawStream::begin(FrameAllocator& frameAllocator) {
+    allocator = &frameAllocator;
+    commands = nullptr;
+    count = capacity = 0;
+}
+
+void DrawStream::record(const Command& command) {
+    // frame memory doesn't grow in place, a full array is copied into one twice its size
+    // and the old one goes with the frame
+    if (count == capacity) {
+        size_t grown = std::max<size_t>(64, capacity * 2);
+        Command* moved = allocator->allocate<Command>(grown);
+        if (count > 0)
+            memcpy(moved, commands, count * sizeof(Command));
+        commands = moved;
+        capacity = grown;
+    }
+    commands[count++] = command;
+}
+
+void DrawStream::replay(const Range& range) const {
+    size_t end = std::min(range.end, count);
+    for (size_t i = range.begin; i < end; i++)
+        execute(commands[i]);
+}
+
+namespace
+{
+    // the program, its per draw uniforms and the instances at instanceOffset of instanceBuffer
+    void bind(const DrawStream::Command& command, GLuint instanceBuffer, GLintptr instanceOffset) {
+        glUseProgram(command.program);
+        if (command.intLocation >= 0)
+            glUniform1i(command.intLocation, command.intValue);
+        if (command.matrixLocation >= 0)
+            glUniformMatrix3fv(command.matrixLocation, 1, GL_FALSE, glm::value_ptr(command.matrixValue));
+
+        glBindVertexArray(command.vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (GLuint column = 0; column < command.instanceColumns; column++)
+            glVertexAttribPointer(command.instanceAttribute + column, 4, GL_FLOAT, GL_FALSE, command.instanceStride,
+                                  (void*)(instanceOffset + column * sizeof(glm::vec4)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void DrawStream::execute(const Command& command) {
+    if (command.instanceCount <= 0)
+        return;
+    bind(command, command.instanceBuffer, command.instanceOffset);
+    if (command.meshCount == 0)
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, command.vertexCount, command.instanceCount);
+    else if (command.instanceCount == 1)
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, command.counts, GL_UNSIGNED_INT, command.offsets,
+                                      command.meshCount, command.baseVertices);
+    else
+        for (GLsizei i = 0; i < command.meshCount; i++)
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.counts[i], GL_UNSIGNED_INT, command.offsets[i],
+                                              command.instanceCount, command.baseVertices[i]);
+    glBindVertexArray(0);
+}
+
+void DrawStream::executeIndirect(const Command& command, GLuint instanceBuffer, GLintptr instanceOffset, GLintptr indirectOffset) {
+    if (command.instanceCount <= 0)
+        return;
+    bind(command, instanceBuffer, instanceOffset);
+    // GL 4.1 has no multi-draw indirect, one draw per mesh
+    if (command.meshCount == 0)
+        glDrawArraysIndirect(GL_TRIANGLE_STRIP, (void*)indirectOffset);
+    else
+        for (GLsizei i = 0; i < command.meshCount; i++)
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(indirectOffset + i * INDIRECT_STRIDE));
+    glBindVertexArray(0);
+}
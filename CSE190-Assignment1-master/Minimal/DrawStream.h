@@ -0,0 +1,91 @@
+#ifndef DRAW_STREAM_H
+#define DRAW_STREAM_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "FrameAllocator.h"
+
+/* DrawStream - the frame's draws, recorded once and replayed for each eye. Recording does all
+   the CPU work of a draw: texture streaming requests, pushing instance data through the
+   stream buffer, picking the ranges to draw. What's left is a flat array of commands in frame
+   memory that only name GL objects and offsets, so an eye pass is one loop of GL calls with
+   the eye's Camera block bound.
+
+   Occlusion culling differs per eye and per phase, so it isn't recorded: each command only
+   knows its first slot in the culler's buffers, and HiZCuller::replay draws the instances it
+   kept with executeIndirect. */
+class DrawStream {
+public:
+    struct Command {
+        GLuint program;
+        GLuint vertexArray;
+        // instance data: columns vec4 attributes from instanceAttribute on, stride bytes per instance
+        GLuint instanceBuffer;
+        GLintptr instanceOffset;
+        GLuint instanceAttribute;
+        GLuint instanceColumns;
+        GLsizei instanceStride;
+        GLsizei instanceCount;
+        GLuint firstVisibility;     // slot of the first instance in occlusion culling
+        // indexed triangles, one draw per mesh (arrays owned by the model), or with meshCount 0
+        // a triangle strip of vertexCount vertices made up by the vertex shader
+        GLsizei meshCount;
+        const GLsizei* counts;
+        const void* const* offsets;
+        const GLint* baseVertices;
+        GLsizei vertexCount;
+        // uniforms of this draw only, location -1 for none
+        GLint intLocation;
+        GLint intValue;
+        GLint matrixLocation;
+        glm::mat3 matrixValue;
+    };
+
+    // commands [begin, end) of the stream
+    struct Range {
+        size_t begin = 0, end = 0;
+    };
+
+    DrawStream() {}
+
+    DrawStream(const DrawStream&) = delete;
+    DrawStream& operator=(const DrawStream&) = delete;
+
+    // once a frame, drops the previous frame's commands (they lived in frameAllocator)
+    void begin(FrameAllocator& frameAllocator);
+    void record(const Command& command);
+    size_t size() const { return count; }
+    // the commands recorded since mark (a size() from before)
+    Range since(size_t mark) const { return Range{ mark, count }; }
+
+    const Command& command(size_t index) const { return commands[index]; }
+
+    // GL thread, with the eye's Camera block bound: the commands of range, every instance
+    void replay(const Range& range) const;
+    // one command straight away, for draws outside the stream
+    static void execute(const Command& command);
+    // bytes per indirect draw, a DrawElementsIndirectCommand; a strip takes the same room and
+    // reads the first four as a DrawArraysIndirectCommand (count, instances, first, 0)
+    static const GLintptr INDIRECT_STRIDE = 5 * sizeof(GLuint);
+    // command with other instances, laid out like its own: instanceOffset into instanceBuffer,
+    // their count in the indirect draws from indirectOffset of the buffer bound to
+    // GL_DRAW_INDIRECT_BUFFER, one per mesh
+    static void executeIndirect(const Command& command, GLuint instanceBuffer, GLintptr instanceOffset, GLintptr indirectOffset);
+
+private:
+    FrameAllocator* allocator{nullptr};
+    Command* commands{nullptr};
+    size_t count{0}, capacity{0};
+};
+
+#endif
@@ -0,0 +1,20 @@
+#include "FrameAllocator.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+const char* FrameAllocator::format(const char* fmt, ...) {
+    va_list args, measure;
+    va_start(args, fmt);
+    va_copy(measure, args);
+    int length = vsnprintf(nullptr, 0, fmt, measure);
+    va_end(measure);
+    if (length < 0) {
+        va_end(args);
+        return "";
+    }
+    char* text = arena.allocate<char>(length + 1);
+    vsnprintf(text, length + 1, fmt, args);
+    va_end(args);
+    return text;
+}
@@ -0,0 +1,31 @@
+#ifndef FRAME_ALLOCATOR_H
+#define FRAME_ALLOCATOR_H
+
+#include "Arena.h"
+
+#include <cstddef>
+
+/* FrameAllocator - scratch memory for data that only lives until the end of the frame:
+   draw packets, matrices, formatted strings. Everything is dropped at once by beginFrame().
+   The arena folds its blocks into one when it is reset, so after the first few frames
+   a frame's worth of data fits in a single block and nothing reaches the heap anymore. */
+class FrameAllocator {
+public:
+    explicit FrameAllocator(size_t bytes = 64 * 1024) : arena(bytes) {}
+
+    // forgets everything handed out during the previous frame
+    void beginFrame() { arena.reset(); }
+
+    template <typename T>
+    T* allocate(size_t count) { return arena.allocate<T>(count); }
+
+    // printf into frame memory, valid until the next beginFrame()
+    const char* format(const char* fmt, ...);
+
+    size_t bytesUsed() const { return arena.bytesUsed(); }
+
+private:
+    Arena arena;
+};
+
+#endif
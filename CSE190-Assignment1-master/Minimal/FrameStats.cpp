@@ -0,0 +1,55 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+FrameStats::FrameStats(size_t capacity) : samples(std::max<size_t>(1, capacity)) {
+}
+
+void FrameStats::frame() {
+    auto now = std::chrono::steady_clock::now();
+    if (started) {
+        samples[next] = std::chrono::duration<float, std::milli>(now - last).count();
+        next = (next + 1) % samples.size();
+        filled = std::min(filled + 1, samples.size());
+    }
+    started = true;
+    last = now;
+}
+
+void FrameStats::reset() {
+    next = 0;
+    filled = 0;
+    started = false;
+}
+
+void FrameStats::report(std::ostream& out, const char* label) const {
+    if (filled == 0) {
+        out << label << ": no frames" << std::endl;
+        return;
+    }
+    std::vector<float> sorted(samples.begin(), samples.begin() + filled);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (float ms : sorted)
+        sum += ms;
+    double mean = sum / filled;
+    double variance = 0.0;
+    for (float ms : sorted)
+        variance += (ms - mean) * (ms - mean);
+    variance /= filled;
+
+    // a hitch is a frame taking half again as long as the average one
+    size_t hitches = sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), (float)(mean * 1.5));
+    auto percentile = [&](double p) { return sorted[std::min(filled - 1, (size_t)(p * filled))]; };
+
+    char line[256];
+    snprintf(line, sizeof(line),
+             "%s: %zu frames, mean %.2f ms, std dev %.3f ms (variance %.3f ms^2), "
+             "p50 %.2f, p99 %.2f, max %.2f ms, %zu hitches",
+             label, filled, mean, std::sqrt(variance), variance,
+             percentile(0.5), percentile(0.99), sorted.back(), hitches);
+    out << line << std::endl;
+}
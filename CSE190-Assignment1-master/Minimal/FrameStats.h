@@ -0,0 +1,33 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+/* FrameStats - frame to frame times of the last few thousand frames, taken at the same
+   point of every frame, so the pacing of different setups (render thread on or off,
+   pinned or not) can be compared: mean, standard deviation, percentiles and hitches. */
+class FrameStats {
+public:
+    explicit FrameStats(size_t capacity = 4096);
+
+    // once per frame, the first call only starts the clock
+    void frame();
+    void reset();
+
+    size_t count() const { return filled; }
+
+    // allocates, call it outside steady-state frames (or in an alloc::Exempt scope)
+    void report(std::ostream& out, const char* label) const;
+
+private:
+    std::vector<float> samples;   // milliseconds, ring buffer
+    size_t next{0};
+    size_t filled{0};
+    bool started{false};
+    std::chrono::steady_clock::time_point last;
+};
+
+#endif
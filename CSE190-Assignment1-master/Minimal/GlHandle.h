@@ -0,0 +1,60 @@
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include "DeletionQueue.h"
+
+/* GlHandle - sole owner of one GL object. Move-only; when the handle is destroyed or
+   reset the object goes to the DeletionQueue, which deletes it (and drops its registry
+   entry) once the GPU is done with it. get() hands out the name for GL calls without
+   giving up ownership. */
+template <ResourceKind Kind>
+class GlHandle {
+public:
+    GlHandle() : id(0) {}
+    // takes ownership of an existing object, e.g. a program from LoadShaders
+    explicit GlHandle(GLuint id) : id(id) {}
+    ~GlHandle() { reset(); }
+
+    GlHandle(GlHandle&& other) noexcept : id(other.release()) {}
+    GlHandle& operator=(GlHandle&& other) noexcept {
+        if (this != &other)
+            reset(other.release());
+        return *this;
+    }
+
+    GlHandle(const GlHandle&) = delete;
+    GlHandle& operator=(const GlHandle&) = delete;
+
+    // a new object of this kind (glGen* / glCreateProgram)
+    static GlHandle create() { return GlHandle(createGlObject(Kind)); }
+
+    GLuint get() const { return id; }
+    explicit operator bool() const { return id != 0; }
+
+    // queues the current object for deletion and owns newId instead
+    void reset(GLuint newId = 0) {
+        if (id != 0)
+            DeletionQueue::instance().defer(Kind, id);
+        id = newId;
+    }
+
+    // gives up ownership without deleting
+    GLuint release() {
+        GLuint released = id;
+        id = 0;
+        return released;
+    }
+
+private:
+    GLuint id;
+};
+
+typedef GlHandle<ResourceKind::Buffer>       BufferHandle;
+typedef GlHandle<ResourceKind::VertexArray>  VertexArrayHandle;
+typedef GlHandle<ResourceKind::Texture>      TextureHandle;
+typedef GlHandle<ResourceKind::Renderbuffer> RenderbufferHandle;
+typedef GlHandle<ResourceKind::Framebuffer>  FramebufferHandle;
+typedef GlHandle<ResourceKind::Program>      ProgramHandle;
+typedef GlHandle<ResourceKind::Query>        QueryHandle;
+
+#endif
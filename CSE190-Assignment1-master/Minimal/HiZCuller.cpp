@@ -0,0 +1,363 @@
+#include "HiZCuller.h"
+#include "ResourceRegistry.h"
+#include "StreamBuffer.h"
+#include "AllocationTracker.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+
+namespace
+{
+    // bit 1 visible last frame, bit 0 visible now; the draws of a phase keep the instances
+    // whose visibility & mask is value
+    const GLuint PHASE_MASKS[] = { 0u, 2u, 3u };
+    const GLuint PHASE_VALUES[] = { 0u, 2u, 1u };
+}
+
+bool HiZCuller::init(const glm::uvec2& targetSize) {
+    copyProgram = ProgramHandle(LoadShaders("hiz.vert", "hiz_copy.frag"));
+    reduceProgram = ProgramHandle(LoadShaders("hiz.vert", "hiz_reduce.frag"));
+    carryProgram = ProgramHandle(LoadFeedbackShader("hiz_carry.vert", "visibility"));
+    cullProgram = ProgramHandle(LoadFeedbackShader("hiz_cull.vert", "visibility"));
+    static const char* const columns[] = { "column0", "column1", "column2", "column3" };
+    compactPrograms[0] = ProgramHandle(LoadFeedbackShader("hiz_compact.vert", "hiz_compact.geom", columns, 1));
+    compactPrograms[1] = ProgramHandle(LoadFeedbackShader("hiz_compact.vert", "hiz_compact.geom", columns, 4));
+    static const char* const draw[] = { "count", "instanceCount", "first", "baseVertex", "reserved" };
+    countProgram = ProgramHandle(LoadFeedbackShader("hiz_count.vert", nullptr, draw, 5));
+    if (!copyProgram || !reduceProgram || !carryProgram || !cullProgram || !compactPrograms[0] || !compactPrograms[1] ||
+        !countProgram) {
+        printf("Hi-Z culling: programs didn't build, drawing everything\n");
+        release();
+        return false;
+    }
+    glProgramUniform1i(copyProgram.get(), glGetUniformLocation(copyProgram.get(), "depth"), TEXTURE_UNIT);
+    glProgramUniform1i(reduceProgram.get(), glGetUniformLocation(reduceProgram.get(), "source"), TEXTURE_UNIT);
+    glProgramUniform1i(carryProgram.get(), glGetUniformLocation(carryProgram.get(), "previousVisibility"), TEXTURE_UNIT);
+    glProgramUniform1i(cullProgram.get(), glGetUniformLocation(cullProgram.get(), "hiZ"), TEXTURE_UNIT);
+    levelsLocation = glGetUniformLocation(cullProgram.get(), "hiZLevels");
+    boundsLocation = glGetUniformLocation(cullProgram.get(), "bounds");
+    viewportLocation = glGetUniformLocation(cullProgram.get(), "viewport");
+    for (int i = 0; i < 2; i++) {
+        compactMaskLocations[i] = glGetUniformLocation(compactPrograms[i].get(), "drawMask");
+        compactValueLocations[i] = glGetUniformLocation(compactPrograms[i].get(), "drawValue");
+    }
+    glProgramUniform1i(countProgram.get(), glGetUniformLocation(countProgram.get(), "visibility"), TEXTURE_UNIT);
+    countMaskLocation = glGetUniformLocation(countProgram.get(), "drawMask");
+    countValueLocation = glGetUniformLocation(countProgram.get(), "drawValue");
+
+    // one float per pixel of the render target on level 0, down to 1x1
+    size = targetSize;
+    levels = 1;
+    while ((size.x >> levels) > 0 || (size.y >> levels) > 0)
+        levels++;
+    pyramid = TextureHandle::create();
+    glBindTexture(GL_TEXTURE_2D, pyramid.get());
+    for (int level = 0; level < levels; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1u, size.x >> level), std::max(1u, size.y >> level), 0,
+                     GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    pyramidFramebuffer = FramebufferHandle::create();
+    pointArray = VertexArrayHandle::create();
+    emptyArray = VertexArrayHandle::create();
+
+    ResourceRegistry& registry = ResourceRegistry::instance();
+    registry.track(ResourceKind::Texture, pyramid.get(), ResourceRegistry::textureBytes(GL_R32F, (int)size.x, (int)size.y, true), "hi-z pyramid");
+    registry.track(ResourceKind::Framebuffer, pyramidFramebuffer.get(), 0, "hi-z framebuffer");
+    registry.track(ResourceKind::VertexArray, pointArray.get(), 0, "hi-z test VAO");
+    registry.track(ResourceKind::VertexArray, emptyArray.get(), 0, "hi-z fullscreen VAO");
+    initialized = true;
+    return true;
+}
+
+void HiZCuller::release() {
+    copyProgram.reset();
+    reduceProgram.reset();
+    carryProgram.reset();
+    cullProgram.reset();
+    compactPrograms[0].reset();
+    compactPrograms[1].reset();
+    countProgram.reset();
+    indirect.reset();
+    indirectCapacity = 0;
+    pyramid.reset();
+    pyramidFramebuffer.reset();
+    pointArray.reset();
+    emptyArray.reset();
+    for (Eye& eye : eyes) {
+        eye.carried.reset();
+        eye.visibility.reset();
+        eye.carriedTexture.reset();
+        eye.visibilityTexture.reset();
+        eye.compacted.reset();
+        eye.slotOf.clear();
+        eye.drawn.clear();
+        eye.capacity = 0;
+    }
+    initialized = false;
+}
+
+void HiZCuller::grow(Eye& eye, unsigned int count) {
+    // more slots than ever: nothing to go on from last frame
+    alloc::Exempt exempt;
+    ResourceRegistry& registry = ResourceRegistry::instance();
+    eye.carried = BufferHandle::create();
+    eye.visibility = BufferHandle::create();
+    glBindBuffer(GL_ARRAY_BUFFER, eye.carried.get());
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, eye.visibility.get());
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    eye.compacted = BufferHandle::create();
+    glBindBuffer(GL_ARRAY_BUFFER, eye.compacted.get());
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    eye.carriedTexture = TextureHandle::create();
+    glBindTexture(GL_TEXTURE_BUFFER, eye.carriedTexture.get());
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, eye.carried.get());
+    eye.visibilityTexture = TextureHandle::create();
+    glBindTexture(GL_TEXTURE_BUFFER, eye.visibilityTexture.get());
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, eye.visibility.get());
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    registry.track(ResourceKind::Buffer, eye.carried.get(), count * sizeof(uint32_t), "hi-z carried visibility");
+    registry.track(ResourceKind::Buffer, eye.visibility.get(), count * sizeof(uint32_t), "hi-z visibility");
+    registry.track(ResourceKind::Buffer, eye.compacted.get(), count * sizeof(glm::mat4), "hi-z compacted instances");
+    registry.track(ResourceKind::Texture, eye.carriedTexture.get(), 0, "hi-z carried visibility (buffer texture)");
+    registry.track(ResourceKind::Texture, eye.visibilityTexture.get(), 0, "hi-z visibility (buffer texture)");
+    eye.slotOf.assign(eye.slotOf.size(), NO_SLOT);
+    eye.drawn.clear();
+    eye.drawn.reserve(count);
+    eye.capacity = count;
+    if (previousSlots.size() < count)
+        previousSlots.resize(count);
+}
+
+void HiZCuller::capture(GLuint program, GLuint output, GLintptr offset, GLsizeiptr size, unsigned int count) {
+    // count points, nothing rasterized, the varyings go straight into size bytes of output from offset
+    glUseProgram(program);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, output, offset, size);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+}
+
+void HiZCuller::beginEye(int index, const uint32_t* order, unsigned int count) {
+    Eye& eye = eyes[index];
+    currentEye = index;
+    currentCount = count;
+    if (count > eye.capacity)
+        grow(eye, count);
+    if (count == 0)
+        return;
+
+    // where each slot's instance was last frame, then remember this frame's slots; the set
+    // drawn can change from frame to frame (instances culled on the CPU get no slot)
+    for (unsigned int i = 0; i < count; i++)
+        if (order[i] >= eye.slotOf.size()) {
+            alloc::Exempt exempt;
+            eye.slotOf.resize(order[i] + 1, NO_SLOT);
+        }
+    for (unsigned int i = 0; i < count; i++)
+        previousSlots[i] = eye.slotOf[order[i]];
+    for (uint32_t instance : eye.drawn)
+        eye.slotOf[instance] = NO_SLOT;
+    eye.drawn.assign(order, order + count);
+    for (unsigned int i = 0; i < count; i++)
+        eye.slotOf[order[i]] = i;
+
+    StreamBuffer::Allocation slots = StreamBuffer::instance().push(previousSlots.data(), count * sizeof(uint32_t), sizeof(uint32_t));
+    glBindVertexArray(pointArray.get());
+    glBindBuffer(GL_ARRAY_BUFFER, slots.buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)slots.offset);
+    for (GLuint column = 1; column < 5; column++)
+        glDisableVertexAttribArray(column);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, eye.visibilityTexture.get());
+    capture(carryProgram.get(), eye.carried.get(), 0, count * sizeof(uint32_t), count);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(0);
+}
+
+bool HiZCuller::compactable(const DrawStream::Command& command) const {
+    return command.instanceCount > 0 && command.firstVisibility + command.instanceCount <= currentCount &&
+           (command.instanceColumns == 1 || command.instanceColumns == 4);
+}
+
+void HiZCuller::replay(const DrawStream& stream, const DrawStream::Range& range, Phase phase) {
+    if (phase == ALL) {
+        stream.replay(range);
+        return;
+    }
+    size_t end = std::min(range.end, stream.size());
+    if (currentCount == 0 || range.begin >= end)
+        return;
+    Eye& eye = eyes[currentEye];
+    GLuint visibility = phase == VISIBLE_LAST_FRAME ? eye.carried.get() : eye.visibility.get();
+    GLuint visibilityTexture = phase == VISIBLE_LAST_FRAME ? eye.carriedTexture.get() : eye.visibilityTexture.get();
+
+    // one indirect draw per mesh, strips take one
+    size_t draws = 0;
+    for (size_t i = range.begin; i < end; i++)
+        if (compactable(stream.command(i)))
+            draws += std::max<size_t>(stream.command(i).meshCount, 1);
+    if (draws == 0)
+        return;
+    if (draws > drawInputs.capacity()) {
+        alloc::Exempt exempt;
+        drawInputs.reserve(std::max(draws, drawInputs.capacity() * 2));
+    }
+    GLsizeiptr indirectBytes = (GLsizeiptr)draws * DrawStream::INDIRECT_STRIDE;
+    if (indirectBytes > indirectCapacity) {
+        indirectCapacity = std::max(indirectBytes, indirectCapacity * 2);
+        indirect = BufferHandle::create();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect.get());
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCapacity, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        ResourceRegistry::instance().track(ResourceKind::Buffer, indirect.get(), indirectCapacity, "hi-z indirect draws");
+    }
+
+    // each command's kept instances, packed from its first slot on
+    for (int i = 0; i < 2; i++) {
+        glProgramUniform1ui(compactPrograms[i].get(), compactMaskLocations[i], PHASE_MASKS[phase]);
+        glProgramUniform1ui(compactPrograms[i].get(), compactValueLocations[i], PHASE_VALUES[phase]);
+    }
+    glBindVertexArray(pointArray.get());
+    drawInputs.clear();
+    for (size_t i = range.begin; i < end; i++) {
+        const DrawStream::Command& command = stream.command(i);
+        if (!compactable(command))
+            continue;
+        glBindBuffer(GL_ARRAY_BUFFER, command.instanceBuffer);
+        for (GLuint column = 0; column < 4; column++) {
+            if (column < command.instanceColumns) {
+                glEnableVertexAttribArray(column);
+                glVertexAttribPointer(column, 4, GL_FLOAT, GL_FALSE, command.instanceStride,
+                                      (void*)(command.instanceOffset + column * sizeof(glm::vec4)));
+            }
+            else
+                glDisableVertexAttribArray(column);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, visibility);
+        glEnableVertexAttribArray(4);
+        glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)(command.firstVisibility * sizeof(uint32_t)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        capture(compactPrograms[command.instanceColumns == 4 ? 1 : 0].get(), eye.compacted.get(),
+                command.firstVisibility * sizeof(glm::mat4), command.instanceCount * command.instanceStride, command.instanceCount);
+
+        if (command.meshCount == 0)
+            drawInputs.push_back({ (uint32_t)command.vertexCount, 0, 0, command.firstVisibility, (uint32_t)command.instanceCount });
+        for (GLsizei mesh = 0; mesh < command.meshCount; mesh++)
+            drawInputs.push_back({ (uint32_t)command.counts[mesh], (uint32_t)((uintptr_t)command.offsets[mesh] / sizeof(GLuint)),
+                                   command.baseVertices[mesh], command.firstVisibility, (uint32_t)command.instanceCount });
+    }
+
+    // how many of them each draw has, straight into its indirect command
+    StreamBuffer::Allocation inputs = StreamBuffer::instance().push(drawInputs.data(), draws * sizeof(DrawInput), sizeof(uint32_t));
+    glBindBuffer(GL_ARRAY_BUFFER, inputs.buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 4, GL_UNSIGNED_INT, sizeof(DrawInput), (void*)inputs.offset);
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(DrawInput), (void*)(inputs.offset + offsetof(DrawInput, slots)));
+    for (GLuint column = 2; column < 5; column++)
+        glDisableVertexAttribArray(column);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glProgramUniform1ui(countProgram.get(), countMaskLocation, PHASE_MASKS[phase]);
+    glProgramUniform1ui(countProgram.get(), countValueLocation, PHASE_VALUES[phase]);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, visibilityTexture);
+    capture(countProgram.get(), indirect.get(), 0, indirectBytes, (unsigned int)draws);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(0);
+
+    // the draws, reading the packed instances with counts that never leave the GPU
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect.get());
+    GLintptr indirectOffset = 0;
+    for (size_t i = range.begin; i < end; i++) {
+        const DrawStream::Command& command = stream.command(i);
+        if (!compactable(command))
+            continue;
+        DrawStream::executeIndirect(command, eye.compacted.get(), command.firstVisibility * sizeof(glm::mat4), indirectOffset);
+        indirectOffset += std::max<GLsizei>(command.meshCount, 1) * DrawStream::INDIRECT_STRIDE;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void HiZCuller::buildPyramid(GLuint depthTexture, GLuint framebuffer, const glm::ivec4& viewport) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pyramidFramebuffer.get());
+    glBindVertexArray(emptyArray.get());
+    glDisable(GL_DEPTH_TEST);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+
+    // only the eye's part of each level, rounded out to whole texels
+    glm::ivec2 lo(viewport.x, viewport.y), hi(viewport.x + viewport.z - 1, viewport.y + viewport.w - 1);
+    for (int level = 0; level < levels; level++) {
+        glm::ivec2 levelSize(std::max(1u, size.x >> level), std::max(1u, size.y >> level));
+        glm::ivec2 a = glm::min(lo >> level, levelSize - 1), b = glm::min(hi >> level, levelSize - 1);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid.get(), level);
+        glViewport(a.x, a.y, b.x - a.x + 1, b.y - a.y + 1);
+        if (level == 0) {
+            glUseProgram(copyProgram.get());
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+        }
+        else {
+            // the level above is the only one the shader can see, so it never reads the one it writes
+            glUseProgram(reduceProgram.get());
+            glBindTexture(GL_TEXTURE_2D, pyramid.get());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBindTexture(GL_TEXTURE_2D, pyramid.get());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(0);
+}
+
+void HiZCuller::test(const glm::mat4* transforms, const glm::vec3& boundsCenter, float boundsRadius, const glm::ivec4& viewport) {
+    Eye& eye = eyes[currentEye];
+    unsigned int count = currentCount;
+    if (count == 0)
+        return;
+
+    StreamBuffer::Allocation instances = StreamBuffer::instance().push(transforms, count * sizeof(glm::mat4), sizeof(glm::vec4));
+    glBindVertexArray(pointArray.get());
+    glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    for (GLuint column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(column);
+        glVertexAttribPointer(column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(instances.offset + column * sizeof(glm::vec4)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, eye.carried.get());
+    glEnableVertexAttribArray(4);
+    glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glProgramUniform1i(cullProgram.get(), levelsLocation, levels);
+    glProgramUniform4f(cullProgram.get(), boundsLocation, boundsCenter.x, boundsCenter.y, boundsCenter.z, boundsRadius);
+    glProgramUniform4f(cullProgram.get(), viewportLocation, (float)viewport.x, (float)viewport.y, (float)viewport.z, (float)viewport.w);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, pyramid.get());
+    capture(cullProgram.get(), eye.visibility.get(), 0, count * sizeof(uint32_t), count);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,120 @@
+#ifndef HIZ_CULLER_H
+#define HIZ_CULLER_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "GlHandle.h"
+#include "DrawStream.h"
+
+/* HiZCuller - two phase occlusion culling of instances on the GPU, per eye.
+
+   Phase one draws the instances that were visible last frame. Their depth is reduced into a
+   hierarchical depth pyramid (every texel the farthest depth of the four below it), and every
+   instance's bounding sphere is tested against the level where its screen rectangle covers
+   at most 2x2 texels. Phase two draws the instances that turned visible, and the result is
+   what phase one draws next frame. An instance hidden by others costs no fragments, and one
+   coming into view shows up in the frame it does.
+
+   GL 4.1 has no compute shaders, so the pyramid is built with fragment passes and the tests
+   run as points in a vertex shader, their results captured by transform feedback. A phase's
+   draws only get the instances it keeps: a geometry shader hands those on to transform
+   feedback, which packs them into the instance stream the draws read, and a vertex shader
+   counts them into indirect draw commands. Without glDrawTransformFeedbackInstanced (4.2) or
+   query buffers (4.4) that is the only way to a GPU side instance count; it never comes back
+   to the CPU. */
+class HiZCuller {
+public:
+    // texture unit for the pyramid and the visibility buffers
+    static const int TEXTURE_UNIT = 9;
+
+    enum Phase {
+        ALL,                  // no culling
+        VISIBLE_LAST_FRAME,   // phase one
+        NEWLY_VISIBLE         // phase two
+    };
+
+    HiZCuller() {}
+
+    HiZCuller(const HiZCuller&) = delete;
+    HiZCuller& operator=(const HiZCuller&) = delete;
+
+    // GL thread: the programs, and a pyramid for a render target of targetSize; false if
+    // a program didn't build, the culler then stays off
+    bool init(const glm::uvec2& targetSize);
+    void release();
+    bool ready() const { return initialized; }
+
+    // per eye, before phase one: order[i] is the instance drawn at slot i this frame, count
+    // may change from frame to frame
+    void beginEye(int eye, const uint32_t* order, unsigned int count);
+
+    // the commands of range with only their instances of phase, for the current eye: after
+    // beginEye for VISIBLE_LAST_FRAME, after test for NEWLY_VISIBLE. Instances are vec4s or
+    // mat4s; with ALL, stream.replay
+    void replay(const DrawStream& stream, const DrawStream::Range& range, Phase phase);
+
+    // after phase one: reduces the eye's part of depthTexture into the pyramid, then
+    // switches back to framebuffer and the eye's viewport (x, y, width, height)
+    void buildPyramid(GLuint depthTexture, GLuint framebuffer, const glm::ivec4& viewport);
+    // tests every slot's bounding sphere (model space center and radius, placed by its transform)
+    void test(const glm::mat4* transforms, const glm::vec3& boundsCenter, float boundsRadius, const glm::ivec4& viewport);
+
+private:
+    static const uint32_t NO_SLOT = 0xffffffffu;
+
+    // input of the count pass per indirect draw, see hiz_count.vert
+    struct DrawInput {
+        uint32_t elements, firstIndex;
+        int32_t baseVertex;
+        uint32_t firstSlot, slots;
+    };
+
+    struct Eye {
+        BufferHandle carried;            // bit 1 per slot, written by the carry pass
+        BufferHandle visibility;         // bits 0 and 1 per slot, written by the test
+        TextureHandle carriedTexture;    // buffer texture over carried, read by the count pass
+        TextureHandle visibilityTexture; // buffer texture over visibility, read by next frame's carry
+        BufferHandle compacted;          // a phase's kept instances, a mat4 of room per slot
+        std::vector<uint32_t> slotOf;    // slot of each instance last frame, NO_SLOT for none
+        std::vector<uint32_t> drawn;     // instances with a slot last frame
+        unsigned int capacity{0};
+    };
+
+    void grow(Eye& eye, unsigned int count);
+    void capture(GLuint program, GLuint output, GLintptr offset, GLsizeiptr size, unsigned int count);
+    bool compactable(const DrawStream::Command& command) const;
+
+    bool initialized{false};
+    ProgramHandle copyProgram, reduceProgram, carryProgram, cullProgram;
+    GLint levelsLocation{-1}, boundsLocation{-1}, viewportLocation{-1};
+    // compaction of vec4 [0] and mat4 [1] instances, and the count pass
+    ProgramHandle compactPrograms[2], countProgram;
+    GLint compactMaskLocations[2]{-1, -1}, compactValueLocations[2]{-1, -1};
+    GLint countMaskLocation{-1}, countValueLocation{-1};
+    BufferHandle indirect;
+    GLsizeiptr indirectCapacity{0};
+    std::vector<DrawInput> drawInputs;
+    TextureHandle pyramid;
+    FramebufferHandle pyramidFramebuffer;
+    VertexArrayHandle pointArray, emptyArray;
+    glm::uvec2 size{0};
+    int levels{0};
+
+    Eye eyes[2];
+    int currentEye{0};
+    unsigned int currentCount{0};
+    std::vector<uint32_t> previousSlots;
+};
+
+#endif
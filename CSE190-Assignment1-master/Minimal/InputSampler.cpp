@@ -0,0 +1,99 @@
+#include "InputSampler.h"
+#include "ThreadTuning.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+void InputSampler::start(double hz) {
+    if (thread.joinable() || hz <= 0.0)
+        return;
+    rate = hz;
+    stopping = false;
+    thread = std::thread(&InputSampler::run, this, hz);
+}
+
+void InputSampler::stop() {
+    if (!thread.joinable())
+        return;
+    stopping = true;
+    thread.join();
+}
+
+void InputSampler::sample() {
+    ovrInputState input;
+    if (!OVR_SUCCESS(ovr_GetInputState(session, ovrControllerType_Touch, &input)))
+        return;
+    // the poses as of now, not predicted for a display time
+    ovrTrackingState tracking = ovr_GetTrackingState(session, 0.0, ovrFalse);
+    ovrPosef handPoses[2] = { tracking.HandPoses[ovrHand_Left].ThePose, tracking.HandPoses[ovrHand_Right].ThePose };
+    double time = ovr_GetTimeInSeconds();
+
+    pushEdges(lastButtons, input.Buttons, Event::PRESSED, Event::RELEASED, time, handPoses);
+    pushEdges(lastTouches, input.Touches, Event::TOUCHED, Event::UNTOUCHED, time, handPoses);
+    lastButtons = input.Buttons;
+    lastTouches = input.Touches;
+    latestButtons.store(input.Buttons, std::memory_order_relaxed);
+    latestTouches.store(input.Touches, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InputSampler::pushEdges(unsigned int previous, unsigned int current, Event::Type on, Event::Type off,
+                             double time, const ovrPosef handPoses[2]) {
+    unsigned int changed = previous ^ current;
+    while (changed) {
+        unsigned int bit = changed & (~changed + 1);
+        changed &= changed - 1;
+        Event event;
+        event.type = (current & bit) ? on : off;
+        event.mask = bit;
+        event.time = time;
+        event.handPoses[0] = handPoses[0];
+        event.handPoses[1] = handPoses[1];
+        if (events.push(event))
+            queued.fetch_add(1, std::memory_order_relaxed);
+        else
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void InputSampler::run(double hz) {
+    typedef std::chrono::steady_clock Clock;
+    threading::setName("input");
+    // a few hundred wakeups a second need sleeps finer than the default timer tick, and
+    // the thread is cheap enough to be let in ahead of everything else
+    threading::raiseTimerResolution();
+    threading::raisePriority();
+
+    Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / hz));
+    Clock::time_point next = Clock::now(), last = next;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        Clock::time_point now = Clock::now();
+        uint64_t gap = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+        if (samples.load(std::memory_order_relaxed) > 0 && gap > maxGapMicroseconds.load(std::memory_order_relaxed))
+            maxGapMicroseconds.store(gap, std::memory_order_relaxed);
+        last = now;
+        sample();
+
+        // fixed schedule; after a stall start over from now rather than catching up in a burst
+        next += interval;
+        if (next < Clock::now())
+            next = Clock::now();
+        std::this_thread::sleep_until(next);
+    }
+    threading::restoreTimerResolution();
+}
+
+void InputSampler::report(std::ostream& out) const {
+    char line[192];
+    if (rate > 0.0) {
+        snprintf(line, sizeof(line), "input: %.0f Hz thread, %llu samples, %llu events, %llu dropped, longest gap %.2f ms",
+                 rate, (unsigned long long)samples.load(), (unsigned long long)queued.load(),
+                 (unsigned long long)dropped.load(), maxGapMicroseconds.load() / 1000.0);
+    }
+    else {
+        snprintf(line, sizeof(line), "input: sampled once per frame, %llu samples, %llu events, %llu dropped",
+                 (unsigned long long)samples.load(), (unsigned long long)queued.load(), (unsigned long long)dropped.load());
+    }
+    out << line << std::endl;
+}
@@ -0,0 +1,76 @@
+#ifndef INPUT_SAMPLER_H
+#define INPUT_SAMPLER_H
+
+#include <OVR_CAPI.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+
+#include "SpscQueue.h"
+
+/* InputSampler - polls the Touch controllers on a thread of its own, a few hundred times a
+   second, instead of once per frame. Every button press or release and every touch or
+   untouch becomes an event stamped with the time it was sampled and both hand poses at that
+   moment, so a tap shorter than a frame still registers, and where the hand was when it
+   happened is known. Events go through a lock-free queue the simulation drains once per
+   frame; the render path never touches input. */
+class InputSampler {
+public:
+    struct Event {
+        enum Type { PRESSED, RELEASED, TOUCHED, UNTOUCHED };
+
+        Type type;
+        unsigned int mask;         // the one ovrButton_ or ovrTouch_ bit that changed
+        double time;               // ovr_GetTimeInSeconds when it was sampled
+        ovrPosef handPoses[2];     // ovrHand_Left, ovrHand_Right at that time
+    };
+
+    explicit InputSampler(ovrSession session) : session(session) {}
+    ~InputSampler() { stop(); }
+
+    InputSampler(const InputSampler&) = delete;
+    InputSampler& operator=(const InputSampler&) = delete;
+
+    // samples hz times a second on the sampling thread; 0 doesn't start one, the simulation
+    // then calls sample() itself once per frame
+    void start(double hz);
+    void stop();
+    bool running() const { return thread.joinable(); }
+
+    // one sample on the calling thread: queues an event per changed bit
+    void sample();
+
+    // simulation thread, the oldest event not taken yet
+    bool poll(Event& event) { return events.pop(event); }
+
+    // as of the latest sample, for things held down rather than pressed
+    unsigned int buttons() const { return latestButtons.load(std::memory_order_relaxed); }
+    unsigned int touches() const { return latestTouches.load(std::memory_order_relaxed); }
+
+    void report(std::ostream& out) const;
+
+private:
+    static const size_t QUEUE_SIZE = 256;    // over half a second of every bit changing at 500 Hz
+
+    void run(double hz);
+    void pushEdges(unsigned int previous, unsigned int current, Event::Type on, Event::Type off,
+                   double time, const ovrPosef handPoses[2]);
+
+    ovrSession session;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    double rate{0.0};
+
+    SpscQueue<Event, QUEUE_SIZE> events;
+    unsigned int lastButtons{0}, lastTouches{0};   // sampling side
+    std::atomic<unsigned int> latestButtons{0}, latestTouches{0};
+
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> queued{0};
+    std::atomic<uint64_t> dropped{0};              // the queue was full
+    std::atomic<uint64_t> maxGapMicroseconds{0};   // longest time between two samples
+};
+
+#endif
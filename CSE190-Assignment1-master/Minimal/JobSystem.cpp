@@ -0,0 +1,291 @@
+#include "JobSystem.h"
+#include "ThreadTuning.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+static_assert(sizeof(JobSystem::Job) == 128, "jobs are meant to be two cache lines");
+
+namespace
+{
+    int64_t ticks() {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    double ticksToMicroseconds(double ticks) {
+        typedef std::chrono::steady_clock::period Period;
+        return ticks * 1e6 * Period::num / Period::den;
+    }
+}
+
+// slot of the calling thread; threads that aren't workers hand theirs back when they exit
+struct SlotOwner {
+    int slot{-1};
+    bool worker{false};
+
+    ~SlotOwner() {
+        if (slot >= 0 && !worker)
+            JobSystem::instance().releaseSlot(slot);
+    }
+};
+
+static thread_local SlotOwner threadSlot;
+
+bool JobSystem::Deque::push(Job* job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= QUEUE_SIZE)
+        return false;
+    entries[b & (QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = entries[b & (QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // last one, race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+    Job* job = entries[t & (QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+JobSystem& JobSystem::instance() {
+    static JobSystem system;
+    return system;
+}
+
+JobSystem::JobSystem() {
+    // one worker per hardware thread, minus the one driving the frame; hardware_concurrency
+    // is 0 when it isn't known
+    unsigned int hw = std::thread::hardware_concurrency();
+    unsigned int threads = hw > 1 ? hw - 1 : 1;
+    threads = std::min<unsigned int>(threads, MAX_THREADS / 2);
+    for (unsigned int i = 0; i < threads; i++) {
+        slots[i].reset(new Slot);
+        slots[i]->jobs.reset(new Job[JOBS_PER_THREAD]());
+        slots[i]->random = 0x9e3779b9u * (i + 1);
+    }
+    slotCount = (int)threads;
+    for (unsigned int i = 0; i < threads; i++)
+        workers.emplace_back(&JobSystem::workerMain, this, (int)i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+int JobSystem::currentSlot() {
+    if (threadSlot.slot >= 0)
+        return threadSlot.slot;
+
+    std::lock_guard<std::mutex> lock(slotMutex);
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = slotCount.load();
+        if (slot >= MAX_THREADS)
+            throw std::runtime_error("JobSystem: too many threads running jobs");
+        slots[slot].reset(new Slot);
+        slots[slot]->jobs.reset(new Job[JOBS_PER_THREAD]());
+        slots[slot]->random = 0x9e3779b9u * (slot + 1);
+        // published last, thieves only look at slots below slotCount
+        slotCount = slot + 1;
+    }
+    threadSlot.slot = slot;
+    return slot;
+}
+
+void JobSystem::releaseSlot(int slot) {
+    // whoever waited on this thread's jobs has seen them finish, its deque is empty
+    std::lock_guard<std::mutex> lock(slotMutex);
+    freeSlots.push_back(slot);
+}
+
+JobSystem::Job* JobSystem::allocate(Job* parent) {
+    int index = currentSlot();
+    Slot& slot = *slots[index];
+    // the ring can come around to jobs still in flight (a parent waiting on its children,
+    // say): skip them, and help out if the whole ring is busy
+    Job* job = &slot.jobs[slot.nextJob++ & (JOBS_PER_THREAD - 1)];
+    for (uint32_t tried = 1; job->unfinished.load(std::memory_order_acquire) > 0; tried++) {
+        if (tried % JOBS_PER_THREAD == 0 && !runOne(index, threadSlot.worker))
+            std::this_thread::yield();
+        job = &slot.jobs[slot.nextJob++ & (JOBS_PER_THREAD - 1)];
+    }
+    job->invoke = nullptr;
+    job->parent = parent;
+    job->unfinished.store(1, std::memory_order_relaxed);
+    if (parent)
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+JobSystem::Job* JobSystem::createEmpty(Job* parent) {
+    return allocate(parent);
+}
+
+void JobSystem::run(Job* job) {
+    job->queuedAt = ticks();
+    int index = currentSlot();
+    if (!slots[index]->deque.push(job)) {
+        // deque full, no point queueing
+        execute(index, job);
+        return;
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    if (sleeping.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+void JobSystem::wait(const Job* job) {
+    int index = currentSlot();
+    bool worker = threadSlot.worker;
+    while (!finished(job)) {
+        if (!runOne(index, worker))
+            std::this_thread::yield();
+    }
+}
+
+bool JobSystem::runOne(int index, bool stealing) {
+    Job* job = slots[index]->deque.pop();
+    if (!job && stealing)
+        job = stealFor(index);
+    if (!job)
+        return false;
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    execute(index, job);
+    return true;
+}
+
+JobSystem::Job* JobSystem::stealFor(int index) {
+    Slot& slot = *slots[index];
+    int count = slotCount.load(std::memory_order_acquire);
+    if (count < 2)
+        return nullptr;
+
+    // start at a random victim so thieves don't all pile onto the same one
+    slot.random ^= slot.random << 13;
+    slot.random ^= slot.random >> 17;
+    slot.random ^= slot.random << 5;
+    int first = (int)(slot.random % (uint32_t)count);
+    for (int i = 0; i < count; i++) {
+        int victim = (first + i) % count;
+        if (victim == index)
+            continue;
+        slot.stealAttempts.fetch_add(1, std::memory_order_relaxed);
+        if (Job* job = slots[victim]->deque.steal()) {
+            slot.steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(int index, Job* job) {
+    Slot& slot = *slots[index];
+    uint64_t latency = (uint64_t)std::max<int64_t>(0, ticks() - job->queuedAt);
+    slot.executed.fetch_add(1, std::memory_order_relaxed);
+    slot.latencyTicks.fetch_add(latency, std::memory_order_relaxed);
+    if (latency > slot.maxLatencyTicks.load(std::memory_order_relaxed))
+        slot.maxLatencyTicks.store(latency, std::memory_order_relaxed);
+
+    if (job->invoke)
+        job->invoke(job);
+    finish(job);
+}
+
+void JobSystem::finish(Job* job) {
+    // read before letting go: once unfinished hits zero the record can be reused
+    Job* parent = job->parent;
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent)
+        finish(parent);
+}
+
+void JobSystem::workerMain(int index) {
+    threadSlot.slot = index;
+    threadSlot.worker = true;
+    threading::setName("jobs");
+    while (!stopping.load(std::memory_order_relaxed)) {
+        if (runOne(index, true))
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1, std::memory_order_acq_rel);
+        wake.wait(lock, [this] { return stopping.load() || queued.load(std::memory_order_acquire) > 0; });
+        sleeping.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+JobSystem::Stats JobSystem::stats() const {
+    Stats stats = {};
+    uint64_t latency = 0, maxLatency = 0;
+    int count = slotCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        const Slot& slot = *slots[i];
+        stats.jobs += slot.executed.load(std::memory_order_relaxed);
+        stats.steals += slot.steals.load(std::memory_order_relaxed);
+        stats.stealAttempts += slot.stealAttempts.load(std::memory_order_relaxed);
+        latency += slot.latencyTicks.load(std::memory_order_relaxed);
+        maxLatency = std::max(maxLatency, slot.maxLatencyTicks.load(std::memory_order_relaxed));
+    }
+    stats.threads = (unsigned int)count;
+    stats.meanLatencyMicroseconds = stats.jobs ? ticksToMicroseconds((double)latency / stats.jobs) : 0.0;
+    stats.maxLatencyMicroseconds = ticksToMicroseconds((double)maxLatency);
+    return stats;
+}
+
+void JobSystem::resetStats() {
+    int count = slotCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        Slot& slot = *slots[i];
+        slot.executed = 0;
+        slot.steals = 0;
+        slot.stealAttempts = 0;
+        slot.latencyTicks = 0;
+        slot.maxLatencyTicks = 0;
+    }
+}
+
+void JobSystem::report(std::ostream& out) const {
+    Stats s = stats();
+    char line[256];
+    snprintf(line, sizeof(line),
+             "jobs: %u workers, %u threads, %llu jobs, %llu steals of %llu attempts, latency mean %.1f us, max %.1f us",
+             workerCount(), s.threads, (unsigned long long)s.jobs, (unsigned long long)s.steals,
+             (unsigned long long)s.stealAttempts, s.meanLatencyMicroseconds, s.maxLatencyMicroseconds);
+    out << line << std::endl;
+}
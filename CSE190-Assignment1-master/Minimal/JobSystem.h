@@ -0,0 +1,183 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* JobSystem - work-stealing jobs for CPU work, per frame (instance transforms) and for
+   assets (imports, mip generation, block compression). Every thread that runs jobs has its
+   own deque: it pushes and pops at the bottom, idle workers steal from the top of the
+   others. Jobs are fixed-size records from a per-thread ring with the function object stored
+   inside, so creating and running one doesn't touch the heap.
+
+   A job is finished once it and all of its children are; wait() keeps running jobs until
+   then. Workers help with anything while they wait, other threads (render, simulation,
+   loaders) only with jobs from their own deque, so a frame never ends up running someone
+   else's texture compression. */
+class JobSystem {
+public:
+    struct Job {
+        static const size_t STORAGE = 96;   // bytes for the function object, 128 per job in all
+
+        void (*invoke)(Job*);
+        Job* parent;
+        std::atomic<int> unfinished;        // this job plus its unfinished children
+        int64_t queuedAt;                   // steady clock ticks at run(), for the latency stats
+        union {
+            unsigned char storage[STORAGE];
+            std::max_align_t align;
+        };
+    };
+
+    struct Stats {
+        unsigned int threads;               // workers plus other threads that ran jobs
+        uint64_t jobs;
+        uint64_t steals;
+        uint64_t stealAttempts;
+        double meanLatencyMicroseconds;     // run() to the job starting
+        double maxLatencyMicroseconds;
+    };
+
+    static JobSystem& instance();
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int workerCount() const { return (unsigned int)workers.size(); }
+
+    // a job calling fn(), a child of parent if given; it starts once passed to run().
+    // fn is stored in the job, so capture big things by reference
+    template <typename F>
+    Job* create(F&& fn, Job* parent = nullptr);
+    // a job doing nothing itself, to wait on a group of children
+    Job* createEmpty(Job* parent = nullptr);
+
+    void run(Job* job);
+    void wait(const Job* job);
+    bool finished(const Job* job) const { return job->unfinished.load(std::memory_order_acquire) == 0; }
+
+    // fn(begin, end) over pieces of [0, count), returns once all are done. The range is
+    // halved into stealable jobs while pieces are bigger than the grain: at least minGrain,
+    // larger for big ranges so there are about eight pieces per thread
+    template <typename F>
+    void parallelFor(size_t count, size_t minGrain, F&& fn);
+
+    Stats stats() const;
+    void resetStats();
+    void report(std::ostream& out) const;
+
+private:
+    static const int MAX_THREADS = 64;
+    static const int64_t QUEUE_SIZE = 4096;   // both powers of two
+    static const uint32_t JOBS_PER_THREAD = 4096;
+
+    // Chase-Lev deque of fixed size: the owner pushes and pops at the bottom, thieves take the top
+    class Deque {
+    public:
+        bool push(Job* job);
+        Job* pop();
+        Job* steal();
+
+    private:
+        std::atomic<int64_t> top{0};
+        std::atomic<int64_t> bottom{0};
+        std::atomic<Job*> entries[QUEUE_SIZE];
+    };
+
+    struct Slot {
+        Deque deque;
+        std::unique_ptr<Job[]> jobs;        // ring the thread's jobs come from
+        uint32_t nextJob{0};
+        uint32_t random{0};                 // xorshift state for picking victims
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> stealAttempts{0};
+        std::atomic<uint64_t> latencyTicks{0};
+        std::atomic<uint64_t> maxLatencyTicks{0};
+    };
+
+    JobSystem();
+
+    int currentSlot();
+    void releaseSlot(int slot);
+    Job* allocate(Job* parent);
+    bool runOne(int slot, bool stealing);
+    Job* stealFor(int slot);
+    void execute(int slot, Job* job);
+    void finish(Job* job);
+    void workerMain(int slot);
+
+    template <typename Body>
+    void splitRange(Job* parent, Body* body, size_t begin, size_t end, size_t grain);
+
+    std::unique_ptr<Slot> slots[MAX_THREADS];
+    std::atomic<int> slotCount{0};
+    std::vector<int> freeSlots;             // of threads that exited, reused by new ones
+    std::mutex slotMutex;
+
+    std::vector<std::thread> workers;
+    std::atomic<int> queued{0};             // jobs in some deque
+    std::atomic<int> sleeping{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{false};
+
+    friend struct SlotOwner;
+};
+
+template <typename F>
+JobSystem::Job* JobSystem::create(F&& fn, Job* parent) {
+    typedef typename std::decay<F>::type Fn;
+    static_assert(sizeof(Fn) <= Job::STORAGE, "job function too big, capture by reference");
+    static_assert(alignof(Fn) <= alignof(std::max_align_t), "job function over-aligned");
+
+    Job* job = allocate(parent);
+    new (job->storage) Fn(std::forward<F>(fn));
+    job->invoke = [](Job* self) {
+        Fn* stored = reinterpret_cast<Fn*>(self->storage);
+        (*stored)();
+        stored->~Fn();
+    };
+    return job;
+}
+
+template <typename Body>
+void JobSystem::splitRange(Job* parent, Body* body, size_t begin, size_t end, size_t grain) {
+    // the upper half becomes a job others can steal, the lower half stays on this thread
+    while (end - begin > grain) {
+        size_t middle = begin + (end - begin) / 2;
+        run(create([this, parent, body, middle, end, grain] { splitRange(parent, body, middle, end, grain); }, parent));
+        end = middle;
+    }
+    (*body)(begin, end);
+}
+
+template <typename F>
+void JobSystem::parallelFor(size_t count, size_t minGrain, F&& fn) {
+    size_t grain = std::max(std::max<size_t>(1, minGrain), count / (8 * (workers.size() + 1)));
+    if (count <= grain) {
+        if (count)
+            fn((size_t)0, count);
+        return;
+    }
+    typedef typename std::remove_reference<F>::type Body;
+    Body* body = &fn;
+    Job* root = createEmpty();
+    splitRange(root, body, 0, count, grain);
+    finish(root);
+    wait(root);
+}
+
+#endif
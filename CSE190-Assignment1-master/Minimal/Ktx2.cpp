@@ -0,0 +1,238 @@
+#include "Ktx2.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    const uint8_t IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+    const size_t HEADER_BYTES = 12 + 9 * 4;   // identifier + 9 header words
+    const size_t INDEX_BYTES = 4 * 4 + 2 * 8; // dfd / kvd offsets and lengths, sgd offset and length
+    const size_t LEVEL_INDEX_BYTES = 3 * 8;   // byteOffset, byteLength, uncompressedByteLength
+
+    // Khronos data format descriptor values used below
+    const uint32_t KHR_DF_MODEL_BC1A = 128;
+    const uint32_t KHR_DF_MODEL_BC3 = 130;
+    const uint32_t KHR_DF_MODEL_BC4 = 131;
+    const uint32_t KHR_DF_MODEL_BC5 = 132;
+    const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+    const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+    const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+    void put32(std::vector<uint8_t>& out, uint32_t v) {
+        for (int i = 0; i < 4; i++)
+            out.push_back((uint8_t)(v >> (8 * i)));
+    }
+
+    void put64(std::vector<uint8_t>& out, uint64_t v) {
+        for (int i = 0; i < 8; i++)
+            out.push_back((uint8_t)(v >> (8 * i)));
+    }
+
+    uint32_t get32(const uint8_t* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    uint64_t get64(const uint8_t* p) {
+        return get32(p) | ((uint64_t)get32(p + 4) << 32);
+    }
+
+    // one 16 byte sample of the basic descriptor block, covering 64 bits of the block
+    void putSample(std::vector<uint8_t>& out, uint32_t bitOffset, uint32_t channel) {
+        put32(out, bitOffset | ((64 - 1) << 16) | (channel << 24));
+        put32(out, 0);          // sample position
+        put32(out, 0);          // sample lower
+        put32(out, 0xFFFFFFFF); // sample upper
+    }
+
+    std::vector<uint8_t> dataFormatDescriptor(BlockFormat format, bool srgb) {
+        uint32_t model = 0;
+        int samples = 0;
+        switch (format) {
+        case BlockFormat::BC1: model = KHR_DF_MODEL_BC1A; samples = 1; break;
+        case BlockFormat::BC3: model = KHR_DF_MODEL_BC3;  samples = 2; break;
+        case BlockFormat::BC4: model = KHR_DF_MODEL_BC4;  samples = 1; break;
+        case BlockFormat::BC5: model = KHR_DF_MODEL_BC5;  samples = 2; break;
+        }
+        uint32_t blockSize = 24 + 16 * samples;
+
+        std::vector<uint8_t> dfd;
+        put32(dfd, 4 + blockSize);                 // dfdTotalSize
+        put32(dfd, 0);                             // vendor Khronos, basic descriptor type
+        put32(dfd, 2 | (blockSize << 16));         // version 1.3 layout, block size
+        uint32_t transfer = srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+        put32(dfd, model | (KHR_DF_PRIMARIES_BT709 << 8) | (transfer << 16));
+        put32(dfd, 3 | (3 << 8));                  // 4x4x1x1 texel blocks, stored as size - 1
+        put32(dfd, (uint32_t)bc::blockBytes(format)); // bytesPlane0
+        put32(dfd, 0);
+
+        switch (format) {
+        case BlockFormat::BC1:
+        case BlockFormat::BC4:
+            putSample(dfd, 0, 0);
+            break;
+        case BlockFormat::BC3:
+            putSample(dfd, 0, 15);  // alpha block first
+            putSample(dfd, 64, 0);  // then color
+            break;
+        case BlockFormat::BC5:
+            putSample(dfd, 0, 0);   // red
+            putSample(dfd, 64, 1);  // green
+            break;
+        }
+        return dfd;
+    }
+}
+
+namespace ktx2
+{
+    uint32_t vkFormat(BlockFormat format, bool srgb) {
+        switch (format) {
+        case BlockFormat::BC1: return srgb ? 132 : 131; // VK_FORMAT_BC1_RGB_SRGB_BLOCK / _UNORM_BLOCK
+        case BlockFormat::BC3: return srgb ? 138 : 137; // VK_FORMAT_BC3_SRGB_BLOCK / _UNORM_BLOCK
+        case BlockFormat::BC4: return 139;              // VK_FORMAT_BC4_UNORM_BLOCK
+        default:               return 141;              // VK_FORMAT_BC5_UNORM_BLOCK
+        }
+    }
+
+    bool blockFormat(uint32_t vk, BlockFormat& format, bool& srgb) {
+        srgb = vk == 132 || vk == 138;
+        switch (vk) {
+        case 131: case 132: format = BlockFormat::BC1; return true;
+        case 137: case 138: format = BlockFormat::BC3; return true;
+        case 139:           format = BlockFormat::BC4; return true;
+        case 141:           format = BlockFormat::BC5; return true;
+        default:            return false;
+        }
+    }
+
+    GLenum glFormat(BlockFormat format, bool srgb) {
+        switch (format) {
+        case BlockFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        default:               return GL_COMPRESSED_RG_RGTC2;
+        }
+    }
+
+    bool write(const std::string& path, const CompressedImage& image) {
+        uint32_t levelCount = (uint32_t)image.levels.size();
+        std::vector<uint8_t> dfd = dataFormatDescriptor(image.format, image.srgb);
+        size_t dfdOffset = HEADER_BYTES + INDEX_BYTES + LEVEL_INDEX_BYTES * levelCount;
+
+        // level data starts after the dfd and is stored smallest mip first,
+        // each level aligned to lcm(block size, 4) which is the block size here
+        size_t align = bc::blockBytes(image.format);
+        std::vector<uint64_t> offsets(levelCount);
+        size_t offset = dfdOffset + dfd.size();
+        for (int level = (int)levelCount - 1; level >= 0; level--) {
+            offset = (offset + align - 1) / align * align;
+            offsets[level] = offset;
+            offset += image.levels[level].size();
+        }
+
+        std::vector<uint8_t> out;
+        out.reserve(offset);
+        out.insert(out.end(), IDENTIFIER, IDENTIFIER + sizeof(IDENTIFIER));
+        put32(out, vkFormat(image.format, image.srgb));
+        put32(out, 1);                // typeSize, 1 for block compressed formats
+        put32(out, image.width);
+        put32(out, image.height);
+        put32(out, 0);                // pixelDepth
+        put32(out, 0);                // layerCount
+        put32(out, 1);                // faceCount
+        put32(out, levelCount);
+        put32(out, 0);                // no supercompression
+
+        put32(out, (uint32_t)dfdOffset);
+        put32(out, (uint32_t)dfd.size());
+        put32(out, 0);                // no key/value data
+        put32(out, 0);
+        put64(out, 0);                // no supercompression global data
+        put64(out, 0);
+
+        for (uint32_t level = 0; level < levelCount; level++) {
+            put64(out, offsets[level]);
+            put64(out, image.levels[level].size());
+            put64(out, image.levels[level].size());
+        }
+        out.insert(out.end(), dfd.begin(), dfd.end());
+
+        for (int level = (int)levelCount - 1; level >= 0; level--) {
+            out.resize(offsets[level], 0);
+            out.insert(out.end(), image.levels[level].begin(), image.levels[level].end());
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        file.write((const char*)out.data(), out.size());
+        return file.good();
+    }
+
+    bool parse(const uint8_t* data, size_t size, ImageView& view) {
+        if (size < HEADER_BYTES + INDEX_BYTES || memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+            return false;
+        const uint8_t* header = data + sizeof(IDENTIFIER);
+        if (!blockFormat(get32(header), view.format, view.srgb))
+            return false;
+        view.width = get32(header + 8);
+        view.height = get32(header + 12);
+        uint32_t levelCount = get32(header + 28);
+        uint32_t supercompression = get32(header + 32);
+        if (supercompression != 0 || levelCount == 0 || get32(header + 24) > 1)
+            return false;
+
+        const uint8_t* levelIndex = data + HEADER_BYTES + INDEX_BYTES;
+        if (size < HEADER_BYTES + INDEX_BYTES + LEVEL_INDEX_BYTES * levelCount)
+            return false;
+        view.levels.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint64_t offset = get64(levelIndex + level * LEVEL_INDEX_BYTES);
+            uint64_t length = get64(levelIndex + level * LEVEL_INDEX_BYTES + 8);
+            if (offset + length > size)
+                return false;
+            view.levels[level].data = data + offset;
+            view.levels[level].size = (size_t)length;
+        }
+        return true;
+    }
+
+    bool read(const std::string& path, CompressedImage& image) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        ImageView view;
+        if (!parse(data.data(), data.size(), view))
+            return false;
+        image.format = view.format;
+        image.srgb = view.srgb;
+        image.width = view.width;
+        image.height = view.height;
+        image.levels.resize(view.levels.size());
+        for (size_t level = 0; level < view.levels.size(); level++)
+            image.levels[level].assign(view.levels[level].data, view.levels[level].data + view.levels[level].size);
+        return true;
+    }
+
+    size_t upload(const CompressedImage& image) {
+        GLenum format = glFormat(image.format, image.srgb);
+        size_t total = 0;
+        int w = image.width, h = image.height;
+        for (size_t level = 0; level < image.levels.size(); level++) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, format, w, h, 0,
+                                   (GLsizei)image.levels[level].size(), image.levels[level].data());
+            total += image.levels[level].size();
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+        }
+        // the file may carry a partial chain, make sure sampling stays within it
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+        return total;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include "TextureCompression.h"
+
+#include <string>
+
+/* Minimal KTX 2.0 container support for the block compressed mip chains produced by
+   TextureCompression: no supercompression, no key/value data, a single 2D image. */
+namespace ktx2
+{
+    // Vulkan format numbers, which is what KTX2 stores. srgb only applies to BC1 / BC3
+    uint32_t vkFormat(BlockFormat format, bool srgb);
+    bool blockFormat(uint32_t vkFormat, BlockFormat& format, bool& srgb);
+
+    // GL internal format to upload a block format with
+    GLenum glFormat(BlockFormat format, bool srgb);
+
+    // levels of a KTX2 file pointing into memory owned by someone else (e.g. a MappedFile)
+    struct ImageView {
+        struct Level {
+            const uint8_t* data;
+            size_t size;
+        };
+        BlockFormat format;
+        bool srgb;
+        int width, height;
+        std::vector<Level> levels;
+    };
+
+    bool parse(const uint8_t* data, size_t size, ImageView& view);
+
+    bool write(const std::string& path, const CompressedImage& image);
+    bool read(const std::string& path, CompressedImage& image);
+
+    // uploads every level with glCompressedTexImage2D into the currently bound GL_TEXTURE_2D,
+    // returns the number of bytes uploaded
+    size_t upload(const CompressedImage& image);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* MappedFile - read only memory mapping of a whole file, so loaders can hand file
+   contents straight to GL without reading them into a heap buffer first. */
+class MappedFile {
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const { return base != nullptr; }
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* base{nullptr};
+    size_t length{0};
+#ifdef _WIN32
+    void* file{nullptr};
+    void* mapping{nullptr};
+#else
+    int fd{-1};
+#endif
+};
+
+#endif
@@ -8,12 +8,15 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "TextureStreamer.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cfloat>
 using namespace std;
 
 struct Vertex {
@@ -29,122 +32,65 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// one level of detail of a mesh: its triangles in the model's index buffer, over the same
+// vertices as the others, and how far (model units) they stray from the full mesh
+struct MeshLod {
+    unsigned int firstIndex, indexCount;
+    float error;
+};
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+/* Mesh - one aiMesh's slice of its model's shared vertex and index buffers. The vertex
+   data itself only lives in the load arena until the model has uploaded it. */
 class Mesh {
 public:
+    // full detail and up to three simplified versions, each with about half the triangles
+    static const int MAX_LODS = 4;
+    // the first texture of each type the mesh's material names
+    enum TextureSlot { DIFFUSE, SPECULAR, NORMAL, HEIGHT, TEXTURE_SLOTS };
+
     /*  Mesh Data  */
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
-    unsigned int VAO;
-	GLuint uProjection, uModelview;
+    // where the mesh sits in its model's shared vertex/index buffers (full detail)
+    unsigned int firstIndex, indexCount;
+    int baseVertex, vertexCount;
+    // levels of detail, lods[0] is the full mesh; a mesh that simplifies less than its
+    // model's others repeats its last level
+    MeshLod lods[MAX_LODS];
+    // texture per slot, 0 for an empty one
+    GLuint textures[TEXTURE_SLOTS];
+    // bounding sphere in model space, used to estimate the mesh's size on screen
+    glm::vec3 boundsCenter;
+    float boundsRadius;
 
     /*  Functions  */
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, the ranges and bounds come from the import
+    Mesh(int vertexCount, int baseVertex, const MeshLod lods[MAX_LODS],
+         const glm::vec3& boundsCenter, float boundsRadius, const GLuint textures[TEXTURE_SLOTS])
+        : firstIndex(lods[0].firstIndex), indexCount(lods[0].indexCount), baseVertex(baseVertex), vertexCount(vertexCount),
+          boundsCenter(boundsCenter), boundsRadius(boundsRadius)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        for (int lod = 0; lod < MAX_LODS; lod++)
+            this->lods[lod] = lods[lod];
+        for (int slot = 0; slot < TEXTURE_SLOTS; slot++)
+            this->textures[slot] = textures[slot];
     }
 
-    // render the mesh
-    void Draw(GLuint shaderProgram, const glm::mat4& projection, const glm::mat4& view, glm::mat4 toWorld)
+    // tell the streamer how big our textures show up so it can bring in the right mips
+    void requestTextures(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& toWorld)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
-			else if(name == "texture_specular")
-				number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-				number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-			    number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-													 // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shaderProgram, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-		glUseProgram(shaderProgram);
-		glm::mat4 modelview = view * toWorld;
-		uProjection = glGetUniformLocation(shaderProgram, "projection");
-		uModelview = glGetUniformLocation(shaderProgram, "modelview");
-		// Now send these values to the shader program
-		glUniformMatrix4fv(uProjection, 1, GL_FALSE, &projection[0][0]);
-		glUniformMatrix4fv(uModelview, 1, GL_FALSE, &modelview[0][0]);
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-		
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
-    }
-
-private:
-    /*  Render data  */
-    unsigned int VBO, EBO;
-
-    /*  Functions    */
-    // initializes all the buffer objects/arrays
-	
-    void setupMesh()
-    {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        TextureStreamer& streamer = TextureStreamer::instance();
+        glm::vec3 viewCenter = glm::vec3(view * toWorld * glm::vec4(boundsCenter, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(toWorld[0])), std::max(glm::length(glm::vec3(toWorld[1])), glm::length(glm::vec3(toWorld[2]))));
+        float distance = std::max(glm::length(viewCenter), 0.001f);
+        float screenPixels = boundsRadius * scale * projection[1][1] / distance * streamer.getViewportHeight();
+        for (int slot = 0; slot < TEXTURE_SLOTS; slot++)
+            if (textures[slot])
+                streamer.request(textures[slot], screenPixels);
     }
-	
 };
-#endif
\ No newline at end of file
+#endif
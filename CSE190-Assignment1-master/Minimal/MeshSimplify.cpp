@@ -0,0 +1,244 @@
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace meshsimplify
+{
+    namespace
+    {
+        // sum of squared distances to a set of planes, as the symmetric matrix of ax + by + cz + d
+        struct Quadric {
+            double aa, ab, ac, ad, bb, bc, bd, cc, cd, dd;
+        };
+
+        void addPlane(Quadric& q, const glm::dvec3& n, double d) {
+            q.aa += n.x * n.x; q.ab += n.x * n.y; q.ac += n.x * n.z; q.ad += n.x * d;
+            q.bb += n.y * n.y; q.bc += n.y * n.z; q.bd += n.y * d;
+            q.cc += n.z * n.z; q.cd += n.z * d;
+            q.dd += d * d;
+        }
+
+        void add(Quadric& q, const Quadric& other) {
+            q.aa += other.aa; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+            q.bb += other.bb; q.bc += other.bc; q.bd += other.bd;
+            q.cc += other.cc; q.cd += other.cd;
+            q.dd += other.dd;
+        }
+
+        // sum of the squared distances of p to the planes; it is never less than the largest
+        // of them, so its square root bounds how far p is from any plane
+        double evaluate(const Quadric& q, const glm::vec3& p) {
+            double x = p.x, y = p.y, z = p.z;
+            double error = q.aa * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+                         + q.bb * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+                         + q.cc * z * z + 2.0 * q.cd * z
+                         + q.dd;
+            return std::max(error, 0.0);
+        }
+
+        struct Collapse {
+            unsigned int from, to;
+            double cost;
+            bool operator<(const Collapse& other) const {
+                if (cost != other.cost)
+                    return cost < other.cost;
+                if (from != other.from)
+                    return from < other.from;
+                return to < other.to;
+            }
+        };
+    }
+
+    size_t simplify(const glm::vec3* positions, size_t stride, size_t vertexCount,
+                    const unsigned int* indices, size_t indexCount,
+                    size_t targetIndexCount, float maxError, unsigned int* out, float* error) {
+        const char* base = (const char*)positions;
+        auto position = [&](unsigned int v) -> const glm::vec3& { return *(const glm::vec3*)(base + v * stride); };
+
+        // working copy without the triangles that are degenerate already
+        std::vector<unsigned int> triangles;
+        triangles.reserve(indexCount);
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            if (a != b && b != c && c != a && a < vertexCount && b < vertexCount && c < vertexCount) {
+                triangles.push_back(a);
+                triangles.push_back(b);
+                triangles.push_back(c);
+            }
+        }
+
+        // vertices welded by position: weld[v] is the first vertex at v's position, and a
+        // position with more than one vertex is a seam
+        std::vector<unsigned int> weld(vertexCount);
+        std::vector<bool> seam(vertexCount, false);
+        {
+            std::vector<unsigned int> byPosition(vertexCount);
+            for (size_t v = 0; v < vertexCount; v++)
+                byPosition[v] = (unsigned int)v;
+            std::sort(byPosition.begin(), byPosition.end(), [&](unsigned int a, unsigned int b) {
+                const glm::vec3 &pa = position(a), &pb = position(b);
+                if (pa.x != pb.x)
+                    return pa.x < pb.x;
+                if (pa.y != pb.y)
+                    return pa.y < pb.y;
+                if (pa.z != pb.z)
+                    return pa.z < pb.z;
+                return a < b;
+            });
+            for (size_t i = 0; i < vertexCount;) {
+                size_t j = i + 1;
+                while (j < vertexCount && position(byPosition[j]) == position(byPosition[i]))
+                    j++;
+                for (size_t k = i; k < j; k++) {
+                    weld[byPosition[k]] = byPosition[i];
+                    seam[byPosition[k]] = j - i > 1;
+                }
+                i = j;
+            }
+        }
+
+        // seams stay where they are, and so do the ends of welded edges with one triangle
+        // (borders) or more than two
+        std::vector<bool> locked(seam);
+        {
+            std::vector<bool> border(vertexCount, false);
+            std::vector<uint64_t> edges;
+            edges.reserve(triangles.size());
+            for (size_t i = 0; i < triangles.size(); i += 3)
+                for (int e = 0; e < 3; e++) {
+                    uint64_t a = weld[triangles[i + e]], b = weld[triangles[i + (e + 1) % 3]];
+                    if (a != b)
+                        edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+                }
+            std::sort(edges.begin(), edges.end());
+            for (size_t i = 0; i < edges.size();) {
+                size_t j = i;
+                while (j < edges.size() && edges[j] == edges[i])
+                    j++;
+                if (j - i != 2) {
+                    border[(size_t)(edges[i] >> 32)] = true;
+                    border[(size_t)(edges[i] & 0xffffffffu)] = true;
+                }
+                i = j;
+            }
+            for (size_t v = 0; v < vertexCount; v++)
+                if (border[weld[v]])
+                    locked[v] = true;
+        }
+
+        // quadric of every vertex from the planes of its triangles
+        std::vector<Quadric> quadrics(vertexCount, Quadric{});
+        for (size_t i = 0; i < triangles.size(); i += 3) {
+            glm::dvec3 p0(position(triangles[i])), p1(position(triangles[i + 1])), p2(position(triangles[i + 2]));
+            glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+            double length = glm::length(n);
+            if (length <= 0.0)
+                continue;
+            n /= length;
+            for (int corner = 0; corner < 3; corner++)
+                addPlane(quadrics[triangles[i + corner]], n, -glm::dot(n, p0));
+        }
+
+        std::vector<unsigned int> remap(vertexCount);
+        std::vector<unsigned int> adjacencyStart(vertexCount + 1), adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<bool> touched(vertexCount);
+        double maxCost = (double)maxError * maxError, worst = 0.0;
+
+        // passes of independent collapses, cheapest first, until the target is reached or
+        // nothing is cheap enough any more
+        while (triangles.size() > targetIndexCount) {
+            // the triangles around every vertex
+            std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0u);
+            for (unsigned int v : triangles)
+                adjacencyStart[v + 1]++;
+            for (size_t v = 0; v < vertexCount; v++)
+                adjacencyStart[v + 1] += adjacencyStart[v];
+            adjacency.resize(triangles.size());
+            {
+                std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+                for (size_t i = 0; i < triangles.size(); i++)
+                    adjacency[fill[triangles[i]]++] = (unsigned int)(i / 3);
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < triangles.size(); i += 3)
+                for (int e = 0; e < 3; e++) {
+                    unsigned int a = triangles[i + e], b = triangles[i + (e + 1) % 3];
+                    Quadric merged = quadrics[a];
+                    add(merged, quadrics[b]);
+                    if (!locked[a])
+                        collapses.push_back(Collapse{ a, b, evaluate(merged, position(b)) });
+                    if (!locked[b])
+                        collapses.push_back(Collapse{ b, a, evaluate(merged, position(a)) });
+                }
+            std::sort(collapses.begin(), collapses.end());
+
+            for (size_t v = 0; v < vertexCount; v++)
+                remap[v] = (unsigned int)v;
+            std::fill(touched.begin(), touched.end(), false);
+            size_t removed = 0, collapsed = 0;
+            size_t wanted = (triangles.size() - targetIndexCount + 2) / 3;
+            for (const Collapse& collapse : collapses) {
+                if (collapse.cost > maxCost || removed >= wanted)
+                    break;
+                if (touched[collapse.from] || touched[collapse.to])
+                    continue;
+
+                // moving from onto to may not turn any remaining triangle around
+                bool flips = false;
+                size_t vanishing = 0;
+                for (unsigned int k = adjacencyStart[collapse.from]; k < adjacencyStart[collapse.from + 1] && !flips; k++) {
+                    const unsigned int* t = &triangles[adjacency[k] * 3];
+                    if (t[0] == collapse.to || t[1] == collapse.to || t[2] == collapse.to) {
+                        vanishing++;
+                        continue;
+                    }
+                    glm::vec3 before[3], after[3];
+                    for (int corner = 0; corner < 3; corner++) {
+                        before[corner] = position(t[corner]);
+                        after[corner] = t[corner] == collapse.from ? position(collapse.to) : before[corner];
+                    }
+                    glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    float l0 = glm::length(n0), l1 = glm::length(n1);
+                    flips = l1 <= 0.0f || glm::dot(n0, n1) < 0.2f * l0 * l1;
+                }
+                if (flips)
+                    continue;
+
+                remap[collapse.from] = collapse.to;
+                add(quadrics[collapse.to], quadrics[collapse.from]);
+                worst = std::max(worst, collapse.cost);
+                // nothing around the changed triangles moves again this pass, so the
+                // adjacency and flip tests stay valid
+                for (unsigned int k = adjacencyStart[collapse.from]; k < adjacencyStart[collapse.from + 1]; k++) {
+                    const unsigned int* t = &triangles[adjacency[k] * 3];
+                    touched[t[0]] = touched[t[1]] = touched[t[2]] = true;
+                }
+                removed += vanishing;
+                collapsed++;
+            }
+            if (collapsed == 0)
+                break;
+
+            size_t kept = 0;
+            for (size_t i = 0; i < triangles.size(); i += 3) {
+                unsigned int a = remap[triangles[i]], b = remap[triangles[i + 1]], c = remap[triangles[i + 2]];
+                if (a == b || b == c || c == a)
+                    continue;
+                triangles[kept++] = a;
+                triangles[kept++] = b;
+                triangles[kept++] = c;
+            }
+            triangles.resize(kept);
+        }
+
+        std::copy(triangles.begin(), triangles.end(), out);
+        if (error)
+            *error = (float)std::sqrt(worst);
+        return triangles.size();
+    }
+}
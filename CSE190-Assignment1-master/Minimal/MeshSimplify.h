@@ -0,0 +1,33 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/* MeshSimplify - coarser versions of a triangle mesh for levels of detail, by quadric error
+   edge collapses (Garland and Heckbert). Every vertex carries the sum of the squared distance
+   quadrics of the planes of its triangles; collapsing an edge moves one end onto the other and
+   costs the merged quadric evaluated there. Only ever collapsing onto an existing vertex means
+   the simplified mesh is just a new index list over the same vertices, so levels of detail
+   share their model's vertex buffer.
+
+   Vertices are welded by position to find the surface's borders, so the mesh should come with
+   identical vertices joined. Vertices on a border stay where they are, and so do the seams
+   where a position is split into several vertices for different texture coordinates or
+   normals, which would tear open otherwise. Collapses that would flip a triangle are skipped.
+   The result only depends on the input, not on timing or threads. */
+namespace meshsimplify
+{
+    // writes at most indexCount indices of a simplified copy of the triangles in indices (over
+    // vertexCount positions, stride bytes apart) to out and returns how many. Stops at
+    // targetIndexCount, or before a collapse could move the surface more than maxError (model
+    // units) away from any of the planes it merged; error, if given, receives that bound for the
+    // collapses made
+    size_t simplify(const glm::vec3* positions, size_t stride, size_t vertexCount,
+                    const unsigned int* indices, size_t indexCount,
+                    size_t targetIndexCount, float maxError, unsigned int* out, float* error = nullptr);
+}
+
+#endif
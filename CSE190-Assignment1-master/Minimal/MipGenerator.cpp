@@ -0,0 +1,278 @@
+#include "MipGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MIP_TARGET_AVX2
+#else
+#define MIP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    const int LINEAR_TO_SRGB_STEPS = 16384;
+
+    // 8 bit sRGB -> linear float, and quantized linear -> 8 bit sRGB
+    struct SrgbTables {
+        float toLinear[256];
+        uint8_t toSrgb[LINEAR_TO_SRGB_STEPS + 1];
+
+        SrgbTables() {
+            for (int i = 0; i < 256; i++) {
+                float s = i / 255.0f;
+                toLinear[i] = s <= 0.04045f ? s / 12.92f : std::pow((s + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i <= LINEAR_TO_SRGB_STEPS; i++) {
+                float l = (float)i / LINEAR_TO_SRGB_STEPS;
+                float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                toSrgb[i] = (uint8_t)std::min(255.0f, s * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    const SrgbTables& srgbTables() {
+        static SrgbTables tables;
+        return tables;
+    }
+
+    enum class SimdPath { Scalar, SSE2, AVX2 };
+
+    SimdPath detectSimd() {
+#ifdef MIP_X86
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+            if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+                __cpuidex(info, 7, 0);
+                if (info[1] & (1 << 5))
+                    return SimdPath::AVX2;
+            }
+        }
+#else
+        if (__builtin_cpu_supports("avx2"))
+            return SimdPath::AVX2;
+#endif
+        return SimdPath::SSE2;
+#else
+        return SimdPath::Scalar;
+#endif
+    }
+
+    // the path generate runs, the best one the CPU has unless a test picked another
+    SimdPath& selectedSimd() {
+        static SimdPath path = detectSimd();
+        return path;
+    }
+
+    SimdPath simd() {
+        return selectedSimd();
+    }
+
+    // working levels are always 4 floats per texel so every path filters whole texels
+    typedef std::vector<float> Level;
+
+    // row y (top row first) of the source as 4 floats a texel, colour in linear light if srgb
+    void decodeRow(const mip::Image& image, bool srgb, size_t y, float* dst) {
+        const float* toLinear = srgbTables().toLinear;
+        size_t row = image.bottomUp ? image.height - 1 - y : y;
+        const uint8_t* src = image.pixels + row * image.stride;
+        for (int x = 0; x < image.width; x++, src += image.channels, dst += 4) {
+            for (int c = 0; c < 4; c++) {
+                if (c >= image.channels)
+                    dst[c] = c == 3 ? 1.0f : 0.0f;
+                else
+                    dst[c] = srgb && c < 3 ? toLinear[src[c]] : src[c] * (1.0f / 255.0f);
+            }
+        }
+    }
+
+    void encodeRows(const float* level, int width, int channels, bool srgb, uint8_t* out, size_t begin, size_t end) {
+        const uint8_t* toSrgb = srgbTables().toSrgb;
+        for (size_t y = begin; y < end; y++) {
+            const float* src = level + y * width * 4;
+            uint8_t* dst = out + y * width * channels;
+            for (int x = 0; x < width; x++, src += 4, dst += channels) {
+                for (int c = 0; c < channels; c++) {
+                    float v = std::min(1.0f, std::max(0.0f, src[c]));
+                    dst[c] = srgb && c < 3 ? toSrgb[(int)(v * LINEAR_TO_SRGB_STEPS + 0.5f)] : (uint8_t)(v * 255.0f + 0.5f);
+                }
+            }
+        }
+    }
+
+    // 2x2 box filter, odd edges reuse their last row / column. Every path adds the two texels of
+    // each row first and then the rows, so they all round the same way and give the same bits
+    void downsampleScalar(const float* r0, const float* r1, int srcWidth, float* dst, int x, int width) {
+        for (; x < width; x++) {
+            int x0 = std::min(2 * x, srcWidth - 1), x1 = std::min(2 * x + 1, srcWidth - 1);
+            for (int c = 0; c < 4; c++)
+                dst[x * 4 + c] = 0.25f * ((r0[x0 * 4 + c] + r0[x1 * 4 + c]) + (r1[x0 * 4 + c] + r1[x1 * 4 + c]));
+        }
+    }
+
+#ifdef MIP_X86
+    // one texel (4 floats) per SSE register
+    void downsampleSSE2(const float* r0, const float* r1, int srcWidth, float* dst, int x, int width) {
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        for (; x < width; x++) {
+            int x0 = std::min(2 * x, srcWidth - 1), x1 = std::min(2 * x + 1, srcWidth - 1);
+            __m128 top = _mm_add_ps(_mm_loadu_ps(r0 + x0 * 4), _mm_loadu_ps(r0 + x1 * 4));
+            __m128 bottom = _mm_add_ps(_mm_loadu_ps(r1 + x0 * 4), _mm_loadu_ps(r1 + x1 * 4));
+            _mm_storeu_ps(dst + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+        }
+    }
+
+    // two output texels per iteration: each 256 bit load holds a horizontal texel pair
+    MIP_TARGET_AVX2
+    void downsampleAVX2(const float* r0, const float* r1, int srcWidth, float* dst, int width) {
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        int x = 0;
+        for (; x + 1 < width && 2 * x + 3 < srcWidth; x += 2) {
+            __m256 a0 = _mm256_loadu_ps(r0 + x * 8), b0 = _mm256_loadu_ps(r0 + x * 8 + 8);   // texels 2x, 2x+1 and 2x+2, 2x+3
+            __m256 a1 = _mm256_loadu_ps(r1 + x * 8), b1 = _mm256_loadu_ps(r1 + x * 8 + 8);
+            __m256 top = _mm256_add_ps(_mm256_permute2f128_ps(a0, b0, 0x20), _mm256_permute2f128_ps(a0, b0, 0x31));
+            __m256 bottom = _mm256_add_ps(_mm256_permute2f128_ps(a1, b1, 0x20), _mm256_permute2f128_ps(a1, b1, 0x31));
+            _mm256_storeu_ps(dst + x * 4, _mm256_mul_ps(_mm256_add_ps(top, bottom), quarter));
+        }
+        downsampleSSE2(r0, r1, srcWidth, dst, x, width);
+    }
+#endif
+
+    void downsampleRow(const float* r0, const float* r1, int srcWidth, float* out, int width) {
+#ifdef MIP_X86
+        SimdPath path = simd();
+        if (path == SimdPath::AVX2)
+            return downsampleAVX2(r0, r1, srcWidth, out, width);
+        if (path == SimdPath::SSE2)
+            return downsampleSSE2(r0, r1, srcWidth, out, 0, width);
+#endif
+        downsampleScalar(r0, r1, srcWidth, out, 0, width);
+    }
+
+    void downsampleRows(const Level& src, int srcWidth, int srcHeight, Level& dst, int width, size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            const float* r0 = &src[(size_t)std::min(2 * (int)y, srcHeight - 1) * srcWidth * 4];
+            const float* r1 = &src[(size_t)std::min(2 * (int)y + 1, srcHeight - 1) * srcWidth * 4];
+            downsampleRow(r0, r1, srcWidth, &dst[y * width * 4], width);
+        }
+    }
+
+    // level 1 straight from the 8 bit source: only the two source rows in flight get decoded,
+    // a float copy of the whole base level would be 16 bytes a texel
+    void downsampleSourceRows(const mip::Image& image, bool srgb, Level& dst, int width, size_t begin, size_t end) {
+        std::vector<float> rows((size_t)image.width * 8);
+        float* r0 = rows.data();
+        float* r1 = rows.data() + (size_t)image.width * 4;
+        for (size_t y = begin; y < end; y++) {
+            size_t y0 = std::min(2 * (int)y, image.height - 1), y1 = std::min(2 * (int)y + 1, image.height - 1);
+            decodeRow(image, srgb, y0, r0);
+            decodeRow(image, srgb, y1, r1);
+            downsampleRow(r0, r1, image.width, &dst[y * width * 4], width);
+        }
+    }
+
+    // runs fn over [0, rows) as jobs of at least 16k texels
+    template <typename F>
+    void forRows(JobSystem* jobs, int rows, int width, F&& fn) {
+        size_t grain = std::max(1, 16384 / std::max(1, width));
+        if (jobs)
+            jobs->parallelFor(rows, grain, fn);
+        else
+            fn(0, rows);
+    }
+}
+
+namespace mip
+{
+    const char* simdPath() {
+        switch (simd()) {
+        case SimdPath::AVX2: return "AVX2";
+        case SimdPath::SSE2: return "SSE2";
+        default:             return "scalar";
+        }
+    }
+
+    bool useSimdPath(const char* path) {
+        SimdPath wanted;
+        if (strcmp(path, "AVX2") == 0)
+            wanted = SimdPath::AVX2;
+        else if (strcmp(path, "SSE2") == 0)
+            wanted = SimdPath::SSE2;
+        else if (strcmp(path, "scalar") == 0)
+            wanted = SimdPath::Scalar;
+        else
+            return false;
+        // anything up to what the CPU has
+        if ((int)wanted > (int)detectSimd())
+            return false;
+        selectedSimd() = wanted;
+        return true;
+    }
+
+    Chain generate(const Image& image, bool srgb, JobSystem* jobs, bool keepBase) {
+        Chain chain;
+        chain.width = image.width;
+        chain.height = image.height;
+        chain.channels = image.channels;
+        chain.srgb = srgb && image.channels >= 3;
+        int levels = 1;
+        while ((std::max(image.width, image.height) >> levels) > 0)
+            levels++;
+        chain.levels.resize(levels);
+
+        // level 0 is the source itself, only repacked
+        if (keepBase) {
+            size_t rowBytes = (size_t)image.width * image.channels;
+            chain.levels[0].resize(rowBytes * image.height);
+            for (int y = 0; y < image.height; y++) {
+                size_t row = image.bottomUp ? image.height - 1 - y : y;
+                memcpy(&chain.levels[0][y * rowBytes], image.pixels + row * image.stride, rowBytes);
+            }
+        }
+
+        int w = image.width, h = image.height;
+        Level current, next;
+        for (int level = 1; level < levels; level++) {
+            int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+            next.resize((size_t)nw * nh * 4);
+            chain.levels[level].resize((size_t)nw * nh * image.channels);
+            uint8_t* out = chain.levels[level].data();
+            forRows(jobs, nh, nw, [&](size_t begin, size_t end) {
+                if (level == 1)
+                    downsampleSourceRows(image, chain.srgb, next, nw, begin, end);
+                else
+                    downsampleRows(current, w, h, next, nw, begin, end);
+                encodeRows(next.data(), nw, image.channels, chain.srgb, out, begin, end);
+            });
+            current.swap(next);
+            w = nw;
+            h = nh;
+        }
+        return chain;
+    }
+
+    size_t upload(const Chain& chain, GLenum internalFormat, GLenum format, int firstLevel) {
+        size_t bytes = 0;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        for (int level = firstLevel; level < (int)chain.levels.size(); level++) {
+            int w = std::max(1, chain.width >> level), h = std::max(1, chain.height >> level);
+            glTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, format, GL_UNSIGNED_BYTE, chain.levels[level].data());
+            bytes += chain.levels[level].size();
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)chain.levels.size() - 1);
+        return bytes;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+/* CPU mip chain generation. Levels are box filtered in floating point; for sRGB images the
+   colour channels are decoded to linear light first and encoded again afterwards, so mips
+   don't darken the way byte averaging of sRGB values does. Filtering is SSE2, or AVX2 where
+   the CPU has it, and rows are spread over the JobSystem. */
+namespace mip
+{
+    // source pixels, 1 to 4 interleaved 8 bit channels per texel
+    struct Image {
+        const uint8_t* pixels;
+        int width, height, channels;
+        size_t stride;    // bytes per row
+        bool bottomUp;    // rows stored last to first (BMP); the chain always comes out top row first
+
+        Image(const uint8_t* pixels, int width, int height, int channels)
+            : pixels(pixels), width(width), height(height), channels(channels),
+              stride((size_t)width * channels), bottomUp(false) {}
+    };
+
+    // full chain down to 1x1, level 0 first, tightly packed with the source's channel count
+    struct Chain {
+        int width, height, channels;
+        bool srgb;
+        std::vector<std::vector<uint8_t>> levels;
+    };
+
+    // srgb: the first three channels are sRGB encoded (ignored for 1 and 2 channel images).
+    // keepBase = false leaves levels[0] empty for callers that upload level 0 themselves.
+    Chain generate(const Image& image, bool srgb, JobSystem* jobs, bool keepBase = true);
+
+    // which filter path generate runs on this CPU: "AVX2", "SSE2" or "scalar"
+    const char* simdPath();
+    // makes generate run path (one of the above) instead, for comparing them; false if the
+    // CPU can't run it. All paths give the same bits
+    bool useSimdPath(const char* path);
+
+    // uploads levels [firstLevel, end) of an 8 bit chain into the bound GL_TEXTURE_2D; format is
+    // the pixel layout of the chain (GL_RGBA, GL_BGR...). Returns the bytes uploaded.
+    size_t upload(const Chain& chain, GLenum internalFormat, GLenum format, int firstLevel = 0);
+}
+
+#endif
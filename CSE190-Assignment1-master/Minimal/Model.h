@@ -13,6 +13,17 @@
 
 #include "Mesh.h"
 #include "shader.h"
+#include "ResourceRegistry.h"
+#include "Arena.h"
+#include "Ktx2.h"
+#include "BmpTexture.h"
+#include "TextureStreamer.h"
+#include "StreamBuffer.h"
+#include "GlHandle.h"
+#include "JobSystem.h"
+#include "UploadThread.h"
+#include "MeshSimplify.h"
+#include "DrawStream.h"
 
 #include <string>
 #include <fstream>
@@ -20,9 +31,57 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <cfloat>
+#include <cstring>
+#include <sys/stat.h>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// writes the block compressed cache TextureFromFile streams from if it is missing or stale,
+// needs no GL context (BMPs are uploaded straight from their file and have no cache)
+void PrepareTextureCache(const char *path, const string &directory, bool gamma = false);
+
+// Levels of detail: a simplified level may stray at most LOD_MAX_ERROR of its mesh's radius
+// from the full mesh. Instances take the coarsest level whose error covers under
+// LOD_ERROR_PIXELS on screen, and only go coarser once it is under LOD_HYSTERESIS times
+// that, so one sitting right at a switching distance doesn't flicker between two levels
+static const float LOD_MAX_ERROR = 0.1f;
+static const float LOD_ERROR_PIXELS = 1.0f;
+static const float LOD_HYSTERESIS = 0.6f;
+
+// the part of a model load that needs no GL context: the file read with assimp, its meshes
+// converted into one arena and the texture caches written. Safe to build on a worker thread,
+// Model's constructor then only uploads.
+struct ModelImport
+{
+    // the model's vertex and index arrays, both in the arena
+    struct Buffers {
+        Vertex* vertices;
+        unsigned int* indices;
+        size_t vertexCount, indexCount;
+    };
+
+    // one mesh's range of the buffers, its levels of detail, its bounding sphere and the file name
+    // of its texture per material slot
+    struct MeshRange {
+        int baseVertex, vertexCount;
+        unsigned int firstIndex, indexCount;
+        MeshLod lods[Mesh::MAX_LODS];
+        glm::vec3 boundsCenter;
+        float boundsRadius;
+        string textures[Mesh::TEXTURE_SLOTS];
+    };
+
+    string path, directory;
+    bool gamma{false};
+    bool valid{false};
+    int lodCount{1};    // levels of detail at least one mesh has
+    unique_ptr<Arena> arena;
+    Buffers buffers{};
+    vector<MeshRange> meshes;
+};
 
 class Model 
 {
@@ -30,178 +89,609 @@ public:
     /*  Model Data */
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh> meshes;
+    string path;
     string directory;
     bool gammaCorrection;
 
     /*  Functions   */
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false) : Model(Import(path, gamma))
     {
-        loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(GLuint shaderProgram, const glm::mat4& projection, const glm::mat4& view, glm::mat4 toWorld)
+    // finishes a load started by Import (on any thread) on the GL thread
+    explicit Model(ModelImport&& import) : gammaCorrection(import.gamma)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shaderProgram, projection, view, toWorld);
+        finishLoad(import);
     }
-    
-private:
-    /*  Functions   */
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // reads and converts the model and prepares its textures, no GL calls
+    static ModelImport Import(string const &path, bool gamma = false)
     {
+        ModelImport import;
+        import.path = path;
+        import.gamma = gamma;
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return import;
         }
         // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        import.directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // the meshes in node order, which is the order they end up in the buffers
+        vector<const aiMesh*> sceneMeshes;
+        collectMeshes(scene->mRootNode, scene, sceneMeshes);
+
+        // every mesh gets its slice of the buffers up front from mNumVertices / mNumFaces (faces are
+        // at most triangles), so the whole import fits one arena block and meshes convert in any order.
+        // The index array has room for the levels of detail behind the full meshes, which together
+        // stay under twice the full index count
+        import.meshes.resize(sceneMeshes.size());
+        size_t vertexCount = 0, indexCount = 0;
+        for (size_t i = 0; i < sceneMeshes.size(); i++)
+        {
+            import.meshes[i].baseVertex = (int)vertexCount;
+            import.meshes[i].firstIndex = (unsigned int)indexCount;
+            vertexCount += sceneMeshes[i]->mNumVertices;
+            indexCount += (size_t)sceneMeshes[i]->mNumFaces * 3;
+        }
+        import.arena = make_unique<Arena>(vertexCount * sizeof(Vertex) + indexCount * 3 * sizeof(unsigned int) + 64);
+        import.buffers.vertices = import.arena->allocate<Vertex>(vertexCount);
+        import.buffers.indices = import.arena->allocate<unsigned int>(indexCount * 3);
+
+        // convert the meshes as jobs, each into its own slice
+        JobSystem::instance().parallelFor(sceneMeshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                processMesh(sceneMeshes[i], scene, import.buffers, import.meshes[i]);
+        });
+
+        // points and lines leave gaps after their slice's indices, close them up in mesh order
+        size_t packedIndices = 0;
+        for (ModelImport::MeshRange& range : import.meshes)
+        {
+            if (range.firstIndex != packedIndices)
+                memmove(import.buffers.indices + packedIndices, import.buffers.indices + range.firstIndex,
+                        range.indexCount * sizeof(unsigned int));
+            range.firstIndex = (unsigned int)packedIndices;
+            packedIndices += range.indexCount;
+        }
+        import.buffers.vertexCount = vertexCount;
+        import.buffers.indexCount = packedIndices;
+        generateLods(import);
+
+        // compress textures now, one job each, the GL thread then only maps the caches
+        vector<pair<string, bool>> prepared;
+        for (const ModelImport::MeshRange& mesh : import.meshes)
+            for (int slot = 0; slot < Mesh::TEXTURE_SLOTS; slot++)
+            {
+                const string& name = mesh.textures[slot];
+                if (name.empty() || std::find_if(prepared.begin(), prepared.end(),
+                        [&](const pair<string, bool>& p) { return p.first == name; }) != prepared.end())
+                    continue;
+                prepared.push_back(make_pair(name, gamma && slot == Mesh::DIFFUSE));
+            }
+        JobSystem::instance().parallelFor(prepared.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                PrepareTextureCache(prepared[i].first.c_str(), import.directory, prepared[i].second);
+        });
+        import.valid = true;
+        return import;
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // GL objects go through their handles (deleted once the GPU is done with them). An
+    // upload still in flight reads from the arena, so it has to land first
+    ~Model()
     {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        if (uploadArena)
         {
-            // the node object only contains indices to index the actual objects in the scene. 
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            UploadThread::instance().wait(uploadTicket);
+            releaseUploadArena();
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
+    }
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // true once the geometry is on the GPU and the model can be drawn; sets up the vertex
+    // array the first time it is, on the GL thread
+    bool ready()
+    {
+        if (!uploadArena)
+            return true;
+        if (!UploadThread::instance().done(uploadTicket))
+            return false;
+        setupVertexArray();
+        releaseUploadArena();
+        return true;
+    }
+
+    // per-instance world transform, a mat4 takes four attribute locations from here on
+    static const GLuint INSTANCE_ATTRIBUTE = 6;
+
+    // model space sphere around every mesh, for culling whole instances
+    void bounds(glm::vec3& center, float& radius) const
+    {
+        center = boundsCenter;
+        radius = boundsRadius;
+    }
+
+    // levels of detail every mesh has (repeating its last one if it has fewer), 1 for none
+    int lodCount() const { return lodLevels; }
+
+    // triangles of all meshes at level lod
+    size_t triangleCount(int lod) const
+    {
+        size_t triangles = 0;
+        for (const Mesh& mesh : meshes)
+            triangles += mesh.lods[lod].indexCount / 3;
+        return triangles;
+    }
+
+    // how many pixels one model unit of an instance covers at most, over views (eyes) whose
+    // viewport is viewportHeight pixels high
+    float pixelsPerUnit(const glm::mat4& toWorld, const glm::mat4* projections, const glm::mat4* views, int viewCount, float viewportHeight) const
+    {
+        glm::vec3 center = glm::vec3(toWorld * glm::vec4(boundsCenter, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(toWorld[0])), std::max(glm::length(glm::vec3(toWorld[1])), glm::length(glm::vec3(toWorld[2]))));
+        float pixels = 0.0f;
+        for (int v = 0; v < viewCount; v++)
         {
-            processNode(node->mChildren[i], scene);
+            float distance = std::max(glm::length(glm::vec3(views[v] * glm::vec4(center, 1.0f))) - boundsRadius * scale, 0.001f);
+            pixels = std::max(pixels, scale * projections[v][1][1] * 0.5f * viewportHeight / distance);
         }
+        return pixels;
+    }
 
+    // level of detail for an instance covering pixelsPerUnit that was drawn at current last frame:
+    // the coarsest level whose error stays under LOD_ERROR_PIXELS, with the margin for going
+    // coarser than current. Errors grow with the level, so the first level too coarse ends it
+    int selectLod(float pixelsPerUnit, int current) const
+    {
+        int lod = 0;
+        while (lod + 1 < lodLevels &&
+               lodErrors[lod + 1] * pixelsPerUnit <= LOD_ERROR_PIXELS * (lod + 1 > current ? LOD_HYSTERESIS : 1.0f))
+            lod++;
+        return lod;
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // draws the model once, with the camera bound at CAMERA_BLOCK_BINDING; projection and
+    // view only decide which texture levels get streamed in
+    void Draw(GLuint shaderProgram, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& toWorld, int lod = 0)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        DrawInstanced(shaderProgram, projection, view, &toWorld, 1, lod);
+    }
 
-        // Walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    // draws count copies of the model, one per world transform. The transforms go through the
+    // stream buffer, so nothing is set per mesh or per instance; a single instance goes out as
+    // one multi-draw covering every mesh. All of them are drawn at level of detail lod
+    void DrawInstanced(GLuint shaderProgram, const glm::mat4& projection, const glm::mat4& view, const glm::mat4* toWorld, GLsizei count,
+                       int lod = 0)
+    {
+        DrawStream::Command command;
+        if (makeCommand(command, shaderProgram, projection, view, toWorld, count, 0, lod))
+            DrawStream::execute(command);
+    }
+
+    // the same draw recorded into stream, to be replayed for each eye: the texture requests
+    // (with projection and view) and the transforms are done once here
+    void RecordInstanced(DrawStream& stream, GLuint shaderProgram, const glm::mat4& projection, const glm::mat4& view,
+                         const glm::mat4* toWorld, GLsizei count, GLuint firstVisibility = 0, int lod = 0)
+    {
+        DrawStream::Command command;
+        if (makeCommand(command, shaderProgram, projection, view, toWorld, count, firstVisibility, lod))
+            stream.record(command);
+    }
+    
+private:
+    /*  Render data  */
+    VertexArrayHandle VAO;
+    BufferHandle VBO, EBO;
+    vector<TextureHandle> ownedTextures;  // the textures in textures_loaded
+    vector<GLsizei> drawCounts[Mesh::MAX_LODS];         // per level of detail
+    vector<const void*> drawOffsets[Mesh::MAX_LODS];
+    vector<GLint> drawBaseVertices;
+    glm::vec3 boundsCenter{0.0f};
+    float boundsRadius{0.0f};
+    int lodLevels{1};
+    float lodErrors[Mesh::MAX_LODS]{};  // largest error of any mesh per level, model units
+    // the import's arena, kept until the upload thread has copied the geometry out of it
+    unique_ptr<Arena> uploadArena;
+    UploadThread::Ticket uploadTicket{0};
+
+    /*  Functions   */
+    // the CPU side of a draw: texture requests, the transforms pushed, the ranges of lod
+    bool makeCommand(DrawStream::Command& command, GLuint shaderProgram, const glm::mat4& projection, const glm::mat4& view,
+                     const glm::mat4* toWorld, GLsizei count, GLuint firstVisibility, int lod)
+    {
+        if (meshes.empty() || count <= 0 || !ready())
+            return false;
+        lod = std::min(std::max(lod, 0), lodLevels - 1);
+        for (GLsizei instance = 0; instance < count; instance++)
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                meshes[i].requestTextures(projection, view, toWorld[instance]);
+
+        StreamBuffer::Allocation instances = StreamBuffer::instance().push(toWorld, count * sizeof(glm::mat4), sizeof(glm::vec4));
+        command = DrawStream::Command();
+        command.program = shaderProgram;
+        command.vertexArray = VAO.get();
+        command.instanceBuffer = instances.buffer;
+        command.instanceOffset = instances.offset;
+        command.instanceAttribute = INSTANCE_ATTRIBUTE;
+        command.instanceColumns = 4;
+        command.instanceStride = sizeof(glm::mat4);
+        command.instanceCount = count;
+        command.firstVisibility = firstVisibility;
+        command.meshCount = (GLsizei)meshes.size();
+        command.counts = drawCounts[lod].data();
+        command.offsets = drawOffsets[lod].data();
+        command.baseVertices = drawBaseVertices.data();
+        command.intLocation = command.matrixLocation = -1;
+        return true;
+    }
+
+    // textures and GL buffers for an import, the arena (and with it the only CPU copy of
+    // the geometry) is released once the upload thread is done with it
+    void finishLoad(ModelImport& import)
+    {
+        path = import.path;
+        directory = import.directory;
+        if (!import.valid)
+            return;
+        ModelImport::Buffers& buffers = import.buffers;
+        meshes.reserve(import.meshes.size());
+        for (const ModelImport::MeshRange& range : import.meshes)
+        {
+            // the first texture of each type makes up the mesh's material, only colour data is sRGB encoded
+            GLuint textures[Mesh::TEXTURE_SLOTS];
+            static const char* typeNames[Mesh::TEXTURE_SLOTS] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+            for (int slot = 0; slot < Mesh::TEXTURE_SLOTS; slot++)
+                textures[slot] = loadMaterialTexture(range.textures[slot], typeNames[slot], gammaCorrection && slot == Mesh::DIFFUSE);
+
+            meshes.push_back(Mesh(range.vertexCount, range.baseVertex, range.lods,
+                                  range.boundsCenter, range.boundsRadius, textures));
+        }
+        lodLevels = import.lodCount;
+        computeBounds();
+        uploadArena = std::move(import.arena);
+        ResourceRegistry::instance().track(ResourceKind::HostMemory, (uint64_t)(uintptr_t)uploadArena.get(),
+                                           uploadArena->bytesReserved(), path + " import arena");
+        setupBuffers(buffers);
+    }
+
+    // the sphere around every mesh and the error of each level of detail over the meshes
+    void computeBounds()
+    {
+        if (meshes.empty())
+            return;
+        glm::vec3 lo(meshes[0].boundsCenter - meshes[0].boundsRadius), hi(meshes[0].boundsCenter + meshes[0].boundsRadius);
+        for (const Mesh& mesh : meshes)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            lo = glm::min(lo, mesh.boundsCenter - mesh.boundsRadius);
+            hi = glm::max(hi, mesh.boundsCenter + mesh.boundsRadius);
+        }
+        boundsCenter = (lo + hi) * 0.5f;
+        for (const Mesh& mesh : meshes)
+            boundsRadius = std::max(boundsRadius, glm::length(mesh.boundsCenter - boundsCenter) + mesh.boundsRadius);
+        for (int lod = 1; lod < lodLevels; lod++)
+        {
+            lodErrors[lod] = lodErrors[lod - 1];
+            for (const Mesh& mesh : meshes)
+                lodErrors[lod] = std::max(lodErrors[lod], mesh.lods[lod].error);
+        }
+    }
+
+    // simplified index lists for every mesh, appended behind the packed full ones. Each level
+    // aims at half the triangles of the one before, simplifying the full mesh again each time
+    // so errors don't pile up; a level that can't get under three quarters of the previous
+    // (seams and borders are locked, or the error budget ran out) ends the mesh's chain and it
+    // repeats its last level from there
+    static void generateLods(ModelImport& import)
+    {
+        ModelImport::Buffers& buffers = import.buffers;
+        vector<vector<unsigned int>> levels[Mesh::MAX_LODS];
+        vector<float> errors[Mesh::MAX_LODS];
+        for (int lod = 1; lod < Mesh::MAX_LODS; lod++)
+        {
+            levels[lod].resize(import.meshes.size());
+            errors[lod].resize(import.meshes.size(), 0.0f);
+        }
+        JobSystem::instance().parallelFor(import.meshes.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
             {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x; 
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
+                const ModelImport::MeshRange& range = import.meshes[i];
+                const unsigned int* indices = buffers.indices + range.firstIndex;
+                size_t previous = range.indexCount;
+                for (int lod = 1; lod < Mesh::MAX_LODS; lod++)
+                {
+                    vector<unsigned int>& level = levels[lod][i];
+                    level.resize(range.indexCount);
+                    size_t count = meshsimplify::simplify(&buffers.vertices[range.baseVertex].Position, sizeof(Vertex), range.vertexCount,
+                                                          indices, range.indexCount, (range.indexCount >> lod) / 3 * 3,
+                                                          LOD_MAX_ERROR * range.boundsRadius, level.data(), &errors[lod][i]);
+                    if (count * 4 > previous * 3)
+                    {
+                        level.clear();
+                        break;
+                    }
+                    level.resize(count);
+                    previous = count;
+                }
             }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-            // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
-            vertices.push_back(vertex);
-        }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        });
+
+        size_t indexCount = buffers.indexCount;
+        for (size_t i = 0; i < import.meshes.size(); i++)
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
-        }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
-    }
-
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
-    {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-        {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            ModelImport::MeshRange& range = import.meshes[i];
+            range.lods[0] = MeshLod{ range.firstIndex, range.indexCount, 0.0f };
+            for (int lod = 1; lod < Mesh::MAX_LODS; lod++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                const vector<unsigned int>& level = levels[lod][i];
+                if (level.empty())
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    range.lods[lod] = range.lods[lod - 1];
+                    continue;
                 }
+                std::copy(level.begin(), level.end(), buffers.indices + indexCount);
+                range.lods[lod] = MeshLod{ (unsigned int)indexCount, (unsigned int)level.size(), errors[lod][i] };
+                indexCount += level.size();
+                import.lodCount = std::max(import.lodCount, lod + 1);
+            }
+        }
+        buffers.indexCount = indexCount;
+    }
+
+    // walks the node tree recursively and lists every mesh reference, a mesh used by two nodes is listed twice.
+    // The node object only contains indices to index the actual objects in the scene,
+    // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+    static void collectMeshes(const aiNode *node, const aiScene *scene, vector<const aiMesh*>& meshes)
+    {
+        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+            meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+        for(unsigned int i = 0; i < node->mNumChildren; i++)
+            collectMeshes(node->mChildren[i], scene, meshes);
+    }
+
+    // frees the import's arena (the registry lists it as host memory while it is kept); after the
+    // upload, or when a model that was never drawn goes with its scene
+    void releaseUploadArena()
+    {
+        if (!uploadArena)
+            return;
+        ResourceRegistry::instance().release(ResourceKind::HostMemory, (uint64_t)(uintptr_t)uploadArena.get());
+        uploadArena.reset();
+    }
+
+    // puts every mesh into one shared vertex and index buffer, meshes were laid out back to back by Import.
+    // The names are made here, the data goes up on the upload thread straight out of the arena
+    void setupBuffers(const ModelImport::Buffers& buffers)
+    {
+        if (meshes.empty())
+        {
+            releaseUploadArena();
+            return;
+        }
+        drawBaseVertices.reserve(meshes.size());
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            drawBaseVertices.push_back((GLint)meshes[i].baseVertex);
+        for (int lod = 0; lod < lodLevels; lod++)
+        {
+            drawCounts[lod].reserve(meshes.size());
+            drawOffsets[lod].reserve(meshes.size());
+            for (unsigned int i = 0; i < meshes.size(); i++)
+            {
+                drawCounts[lod].push_back((GLsizei)meshes[i].lods[lod].indexCount);
+                drawOffsets[lod].push_back((const void*)(meshes[i].lods[lod].firstIndex * sizeof(unsigned int)));
             }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        }
+
+        // create buffers/arrays
+        VAO = VertexArrayHandle::create();
+        VBO = BufferHandle::create();
+        EBO = BufferHandle::create();
+
+        // A great thing about structs is that their memory layout is sequential for all its items.
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+        // again translates to 3/2 floats which translates to a byte array.
+        // No VAO is bound on the upload context, so the element buffer goes through GL_ARRAY_BUFFER as well
+        GLuint vbo = VBO.get(), ebo = EBO.get();
+        ModelImport::Buffers data = buffers;
+        uploadTicket = UploadThread::instance().submit([vbo, ebo, data] {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, data.vertexCount * sizeof(Vertex), data.vertices, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, ebo);
+            glBufferData(GL_ARRAY_BUFFER, data.indexCount * sizeof(unsigned int), data.indices, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        });
+
+        ResourceRegistry& registry = ResourceRegistry::instance();
+        registry.track(ResourceKind::VertexArray, VAO.get(), 0, path + " VAO");
+        registry.track(ResourceKind::Buffer, VBO.get(), buffers.vertexCount * sizeof(Vertex), path + " VBO");
+        registry.track(ResourceKind::Buffer, EBO.get(), buffers.indexCount * sizeof(unsigned int), path + " EBO");
+    }
+
+    // points the vertex array at the uploaded buffers. Vertex arrays aren't shared between
+    // contexts, so this waits for the upload and happens on the GL thread
+    void setupVertexArray()
+    {
+        glBindVertexArray(VAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+
+        // set the vertex attribute pointers
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // instance transforms, pointed at this frame's stream buffer range by each draw
+        for (GLuint column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + column);
+            glVertexAttribDivisor(INSTANCE_ATTRIBUTE + column, 1);
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // converts mesh into its slice of the import buffers, result comes in with baseVertex and firstIndex
+    // set. Runs as a job: big meshes convert their vertices as jobs of their own
+    static void processMesh(const aiMesh *mesh, const aiScene *scene, ModelImport::Buffers& buffers, ModelImport::MeshRange& result)
+    {
+        // data to fill
+        Vertex* vertices = buffers.vertices + result.baseVertex;
+        unsigned int* indices = buffers.indices + result.firstIndex;
+
+        // Walk through each of the mesh's vertices
+        JobSystem::instance().parallelFor(mesh->mNumVertices, 16384, [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++)
+            {
+                Vertex& vertex = vertices[i];
+                // positions
+                vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                // normals
+                if(mesh->mNormals)
+                    vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                else
+                    vertex.Normal = glm::vec3(0.0f);
+                // texture coordinates
+                if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+                {
+                    // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
+                    // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+                    vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                }
+                else
+                    vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                // tangent and bitangent, assimp only computes them for meshes with texture coordinates
+                if(mesh->mTangents)
+                {
+                    vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                    vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+                }
+                else
+                {
+                    vertex.Tangent = glm::vec3(0.0f);
+                    vertex.Bitangent = glm::vec3(0.0f);
+                }
             }
+        });
+        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        // (by reference: copying an aiFace allocates a copy of its index array). Triangulate leaves
+        // lines and points as they are, they'd shift every later triangle in the index buffer
+        unsigned int indexCount = 0;
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            if(face.mNumIndices != 3)
+                continue;
+            for(unsigned int j = 0; j < 3; j++)
+                indices[indexCount++] = face.mIndices[j];
+        }
+        result.vertexCount = (int)mesh->mNumVertices;
+        result.indexCount = indexCount;
+
+        // bounding sphere around the box of all positions, used to estimate the mesh's size on screen
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            lo = glm::min(lo, vertices[i].Position);
+            hi = glm::max(hi, vertices[i].Position);
+        }
+        result.boundsCenter = mesh->mNumVertices == 0 ? glm::vec3(0.0f) : (lo + hi) * 0.5f;
+        result.boundsRadius = mesh->mNumVertices == 0 ? 0.0f : glm::length(hi - lo) * 0.5f;
+
+        // process materials, the first texture of each type makes up the mesh's material
+        const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        result.textures[Mesh::DIFFUSE] = materialTextureName(material, aiTextureType_DIFFUSE);
+        result.textures[Mesh::SPECULAR] = materialTextureName(material, aiTextureType_SPECULAR);
+        result.textures[Mesh::NORMAL] = materialTextureName(material, aiTextureType_HEIGHT);
+        result.textures[Mesh::HEIGHT] = materialTextureName(material, aiTextureType_AMBIENT);
+    }
+
+    // file name of the material's first texture of a given type, empty if it has none
+    static string materialTextureName(const aiMaterial *mat, aiTextureType type)
+    {
+        if(mat->GetTextureCount(type) == 0)
+            return string();
+        aiString str;
+        mat->GetTexture(type, 0, &str);
+        return str.C_Str();
+    }
+
+    // loads a texture if it isn't loaded yet, 0 for no texture
+    GLuint loadMaterialTexture(const string &name, const char *typeName, bool gamma)
+    {
+        if(name.empty())
+            return 0;
+        // check if texture was loaded before and if so, share it
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if(textures_loaded[j].path == name)
+                return textures_loaded[j].id;
         }
-        return textures;
+        Texture texture;
+        texture.id = TextureFromFile(name.c_str(), this->directory, gamma);
+        texture.type = typeName;
+        texture.path = name;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        ownedTextures.push_back(TextureHandle(texture.id));
+        return texture.id;
     }
 };
 
 
+// modification time of a file, -1 if it doesn't exist
+static long long fileModifiedTime(const string &path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return -1;
+    return (long long)info.st_mtime;
+}
+
+// a block compressed copy (BC1/BC3/BC4/BC5 + mips) is written next to the source the
+// first time a texture is loaded. From then on no decode and no mip generation: the
+// streamer maps that file and uploads only the levels the texture's screen size calls for.
+// Colour textures are cached as sRGB formats, data textures linear, so keep them apart
+static string textureCachePath(const string &filename, bool gamma)
+{
+    return filename + (gamma ? ".srgb.ktx2" : ".ktx2");
+}
+
+void PrepareTextureCache(const char *path, const string &directory, bool gamma)
+{
+    string filename = directory + '/' + path;
+    string cachePath = textureCachePath(filename, gamma);
+    if (bmp::isBmp(filename) || fileModifiedTime(cachePath) >= fileModifiedTime(filename))
+        return;
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        CompressedImage image = bc::compress(data, width, height, nrComponents, gamma);
+        if (!ktx2::write(cachePath, image))
+            std::cout << "Could not write texture cache: " << cachePath << std::endl;
+    }
+    stbi_image_free(data);
+}
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
@@ -210,33 +700,61 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    string cachePath = textureCachePath(filename, gamma);
+    TextureStreamer& streamer = TextureStreamer::instance();
+    bool streamed = fileModifiedTime(cachePath) >= fileModifiedTime(filename) && streamer.load(textureID, cachePath);
+    bool uploaded = false;
+
+    // uncompressed BMPs already hold raw BGR rows, upload them right out of a file mapping
+    if (!streamed && bmp::isBmp(filename))
     {
+        int width, height;
         GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        if (bmp::uploadMapped(filename, gamma, width, height, format))
+        {
+            ResourceRegistry::instance().track(ResourceKind::Texture, textureID,
+                                               ResourceRegistry::textureBytes(format, width, height, true), filename);
+            uploaded = true;
+        }
+    }
+
+    if (!streamed && !uploaded)
+    {
+        int width, height, nrComponents;
+        unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+        if (data)
+        {
+            CompressedImage image = bc::compress(data, width, height, nrComponents, gamma);
+            if (ktx2::write(cachePath, image))
+                streamed = streamer.load(textureID, cachePath);
+            else
+                std::cout << "Could not write texture cache: " << cachePath << std::endl;
+            if (!streamed)
+            {
+                // nothing to stream from, upload the whole chain
+                glBindTexture(GL_TEXTURE_2D, textureID);
+                size_t bytes = ktx2::upload(image);
+                ResourceRegistry::instance().track(ResourceKind::Texture, textureID, bytes, filename);
+                uploaded = true;
+            }
+        }
+        stbi_image_free(data);
+    }
 
+    if (streamed || uploaded)
+    {
+        glBindTexture(GL_TEXTURE_2D, textureID);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        glBindTexture(GL_TEXTURE_2D, 0);
     }
     else
     {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        ResourceRegistry::instance().track(ResourceKind::Texture, textureID, 0, filename + " (failed to load)");
     }
 
     return textureID;
@@ -0,0 +1,100 @@
+#include "PassQueries.h"
+#include "ResourceRegistry.h"
+
+#include <cstdio>
+
+void PassQueries::begin(int variant, bool continues) {
+    if (inFlight == RING) {
+        skipped++;
+        return;
+    }
+    int slot = (oldest + inFlight) % RING;
+    if (!timeQueries[slot]) {
+        timeQueries[slot] = QueryHandle::create();
+        sampleQueries[slot] = QueryHandle::create();
+        ResourceRegistry::instance().track(ResourceKind::Query, timeQueries[slot].get(), 0, name + " time query");
+        ResourceRegistry::instance().track(ResourceKind::Query, sampleQueries[slot].get(), 0, name + " samples query");
+    }
+    variants[slot] = variant;
+    continued[slot] = continues;
+    glBeginQuery(GL_TIME_ELAPSED, timeQueries[slot].get());
+    glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[slot].get());
+    active = true;
+}
+
+void PassQueries::end() {
+    if (!active)
+        return;
+    glEndQuery(GL_SAMPLES_PASSED);
+    glEndQuery(GL_TIME_ELAPSED);
+    active = false;
+    inFlight++;
+}
+
+void PassQueries::collect() {
+    // passes finish in order, the first one not done yet ends the search
+    while (inFlight > 0) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(sampleQueries[oldest].get(), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+            glGetQueryObjectuiv(timeQueries[oldest].get(), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 nanoseconds = 0, samples = 0;
+        glGetQueryObjectui64v(timeQueries[oldest].get(), GL_QUERY_RESULT, &nanoseconds);
+        glGetQueryObjectui64v(sampleQueries[oldest].get(), GL_QUERY_RESULT, &samples);
+        Totals& t = totals[variants[oldest]];
+        if (!continued[oldest])
+            t.passes++;
+        t.samples += samples;
+        t.milliseconds += nanoseconds / 1e6;
+        oldest = (oldest + 1) % RING;
+        inFlight--;
+    }
+}
+
+void PassQueries::reset() {
+    for (Totals& t : totals)
+        t = Totals();
+    skipped = 0;
+}
+
+void PassQueries::release() {
+    for (int slot = 0; slot < RING; slot++) {
+        timeQueries[slot].reset();
+        sampleQueries[slot].reset();
+    }
+    oldest = 0;
+    inFlight = 0;
+    active = false;
+}
+
+void PassQueries::report(std::ostream& out, const char* const variantNames[VARIANTS], int baseline) const {
+    char line[192];
+    for (int v = 0; v < VARIANTS; v++) {
+        const Totals& t = totals[v];
+        if (!t.passes)
+            continue;
+        snprintf(line, sizeof(line), "%s, %s: %llu passes, %.3f ms GPU and %.0f fragments shaded per pass",
+                 name.c_str(), variantNames[v], (unsigned long long)t.passes, t.milliseconds / t.passes,
+                 (double)t.samples / t.passes);
+        out << line << std::endl;
+    }
+    // the same scene different ways: how much of the shading each saves over the baseline
+    const Totals& base = totals[baseline];
+    for (int v = 0; v < VARIANTS; v++) {
+        const Totals& t = totals[v];
+        if (v == baseline || !t.passes || !base.passes || !base.samples || base.milliseconds <= 0.0)
+            continue;
+        double samples = ((double)t.samples / t.passes) / ((double)base.samples / base.passes);
+        double time = (t.milliseconds / t.passes) / (base.milliseconds / base.passes);
+        snprintf(line, sizeof(line), "%s: %s shades %.0f%% of the fragments of %s, in %.0f%% of the GPU time",
+                 name.c_str(), variantNames[v], samples * 100.0, variantNames[baseline], time * 100.0);
+        out << line << std::endl;
+    }
+    if (skipped) {
+        snprintf(line, sizeof(line), "%s: %llu passes not measured, results came back too slowly",
+                 name.c_str(), (unsigned long long)skipped);
+        out << line << std::endl;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef PASS_QUERIES_H
+#define PASS_QUERIES_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "GlHandle.h"
+
+/* PassQueries - GPU time (GL_TIME_ELAPSED) and fragments that passed the depth test
+   (GL_SAMPLES_PASSED) of one render pass. Results are read back a few frames late, once
+   they are available, so measuring never stalls on the GPU. Each pass is counted under a
+   variant (e.g. sorted or not), so different ways of drawing the same thing can be compared
+   in one run by switching between them. A pass interrupted by other work can be measured
+   in pieces, the pieces after the first continue it. */
+class PassQueries {
+public:
+    static const int VARIANTS = 8;
+
+    explicit PassQueries(const std::string& name) : name(name) {}
+
+    PassQueries(const PassQueries&) = delete;
+    PassQueries& operator=(const PassQueries&) = delete;
+
+    // around the pass on the GL thread; passes not nested, one variant < VARIANTS per pass
+    void begin(int variant, bool continues = false);
+    void end();
+
+    // once a frame: reads back every pass whose results have arrived
+    void collect();
+    void reset();
+    // deletes the query objects (results still in flight are lost), while the context is there
+    void release();
+
+    // one line per variant measured, and how each compares to the baseline variant
+    void report(std::ostream& out, const char* const variantNames[VARIANTS], int baseline = 0) const;
+
+private:
+    static const int RING = 16;   // passes in flight, a few frames of both eyes
+
+    struct Totals {
+        uint64_t passes;
+        uint64_t samples;
+        double milliseconds;
+    };
+
+    std::string name;
+    QueryHandle timeQueries[RING], sampleQueries[RING];
+    int variants[RING];
+    bool continued[RING];
+    int oldest{0}, inFlight{0};
+    bool active{false};
+    uint64_t skipped{0};           // passes not measured because the ring was full
+    Totals totals[VARIANTS] = {};
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "ResourceRegistry.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+ResourceRegistry& ResourceRegistry::instance() {
+    static ResourceRegistry registry;
+    return registry;
+}
+
+ResourceRegistry::ResourceRegistry() : epoch(std::chrono::steady_clock::now()) {
+}
+
+double ResourceRegistry::now() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void ResourceRegistry::track(ResourceKind kind, uint64_t id, size_t bytes, const std::string& owner) {
+    ResourceRecord record;
+    record.kind = kind;
+    record.id = id;
+    record.bytes = bytes;
+    record.owner = owner;
+    record.created = now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    records[Key((int)kind, id)] = record;
+}
+
+void ResourceRegistry::resize(ResourceKind kind, uint64_t id, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = records.find(Key((int)kind, id));
+    if (it != records.end())
+        it->second.bytes = bytes;
+}
+
+void ResourceRegistry::release(ResourceKind kind, uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    records.erase(Key((int)kind, id));
+}
+
+size_t ResourceRegistry::totalBytes(ResourceKind kind) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto& entry : records)
+        if (entry.second.kind == kind)
+            total += entry.second.bytes;
+    return total;
+}
+
+size_t ResourceRegistry::count(ResourceKind kind) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto& entry : records)
+        if (entry.second.kind == kind)
+            total++;
+    return total;
+}
+
+void ResourceRegistry::report(std::ostream& out) const {
+    // copy under the lock, format without it
+    std::vector<ResourceRecord> live;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        live.reserve(records.size());
+        for (const auto& entry : records)
+            live.push_back(entry.second);
+    }
+    std::sort(live.begin(), live.end(), [](const ResourceRecord& a, const ResourceRecord& b) {
+        return a.bytes > b.bytes;
+    });
+
+    size_t bytes[(int)ResourceKind::Count] = {};
+    size_t counts[(int)ResourceKind::Count] = {};
+    size_t gpuBytes = 0;
+    for (const ResourceRecord& r : live) {
+        bytes[(int)r.kind] += r.bytes;
+        counts[(int)r.kind]++;
+        if (r.kind != ResourceKind::HostMemory)
+            gpuBytes += r.bytes;
+    }
+
+    out << "********* MEMORY REPORT (" << std::fixed << std::setprecision(2) << now() << "s) *********" << '\n';
+    for (int k = 0; k < (int)ResourceKind::Count; k++) {
+        out << "  " << std::left << std::setw(14) << kindName((ResourceKind)k) << std::right
+            << std::setw(6) << counts[k] << " objects " << std::setw(12) << bytes[k] / 1024.0 << " KiB" << '\n';
+    }
+    out << "  GPU total " << gpuBytes / (1024.0 * 1024.0) << " MiB, host total "
+        << bytes[(int)ResourceKind::HostMemory] / (1024.0 * 1024.0) << " MiB" << '\n';
+    for (const ResourceRecord& r : live) {
+        out << "    " << std::left << std::setw(14) << kindName(r.kind) << std::right
+            << std::setw(8) << (r.kind == ResourceKind::HostMemory ? 0 : r.id)
+            << std::setw(12) << r.bytes << " B  t=" << std::setw(8) << r.created << "s  " << r.owner << '\n';
+    }
+    out.unsetf(std::ios::floatfield);
+    out << std::flush;
+}
+
+const char* ResourceRegistry::kindName(ResourceKind kind) {
+    switch (kind) {
+    case ResourceKind::Buffer:       return "buffer";
+    case ResourceKind::VertexArray:  return "vertex array";
+    case ResourceKind::Texture:      return "texture";
+    case ResourceKind::Renderbuffer: return "renderbuffer";
+    case ResourceKind::Framebuffer:  return "framebuffer";
+    case ResourceKind::Program:      return "program";
+    case ResourceKind::Query:        return "query";
+    case ResourceKind::HostMemory:   return "host memory";
+    default:                         return "unknown";
+    }
+}
+
+size_t ResourceRegistry::textureBytes(GLenum internalFormat, int width, int height, bool mipmapped) {
+    size_t texel;
+    switch (internalFormat) {
+    case GL_RED:
+    case GL_R8:
+        texel = 1;
+        break;
+    case GL_RG:
+    case GL_RG8:
+    case GL_DEPTH_COMPONENT16:
+        texel = 2;
+        break;
+    default:
+        // RGB8 is padded to 4 bytes per texel by every driver we care about
+        texel = 4;
+        break;
+    }
+
+    size_t total = 0;
+    while (true) {
+        total += (size_t)width * height * texel;
+        if (!mipmapped || (width == 1 && height == 1))
+            break;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return total;
+}
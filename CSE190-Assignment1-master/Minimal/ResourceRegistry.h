@@ -0,0 +1,75 @@
+#ifndef RESOURCE_REGISTRY_H
+#define RESOURCE_REGISTRY_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// Kinds of resources the registry keeps track of. HostMemory covers CPU side
+// copies (e.g. the vertex / index vectors a Mesh keeps around after upload).
+enum class ResourceKind {
+    Buffer,
+    VertexArray,
+    Texture,
+    Renderbuffer,
+    Framebuffer,
+    Program,
+    Query,
+    HostMemory,
+    Count
+};
+
+struct ResourceRecord {
+    ResourceKind kind;
+    uint64_t     id;       // GL object name, or the address for HostMemory
+    size_t       bytes;    // estimated size of the storage
+    std::string  owner;    // who created it, e.g. "webtrcc.obj#mesh0 VBO"
+    double       created;  // seconds since the registry was created
+};
+
+/* ResourceRegistry - book keeping for every GL object and retained CPU buffer the
+   project creates, so a live report (or the one dumped at exit) shows where the
+   memory goes and what was never released. */
+class ResourceRegistry {
+public:
+    static ResourceRegistry& instance();
+
+    // register a new resource; tracking an existing (kind, id) pair replaces it
+    void track(ResourceKind kind, uint64_t id, size_t bytes, const std::string& owner);
+    // update the size of an already tracked resource (re-upload, orphaning...)
+    void resize(ResourceKind kind, uint64_t id, size_t bytes);
+    // forget a resource once it has been deleted
+    void release(ResourceKind kind, uint64_t id);
+
+    size_t totalBytes(ResourceKind kind) const;
+    size_t count(ResourceKind kind) const;
+
+    // prints per kind totals followed by every live resource, largest first
+    void report(std::ostream& out) const;
+
+    static const char* kindName(ResourceKind kind);
+    // estimated storage of a 2D texture, including the mip chain when present
+    static size_t textureBytes(GLenum internalFormat, int width, int height, bool mipmapped);
+
+private:
+    ResourceRegistry();
+    double now() const;
+
+    typedef std::pair<int, uint64_t> Key;
+    std::map<Key, ResourceRecord> records;
+    mutable std::mutex mutex;
+    std::chrono::steady_clock::time_point epoch;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "SceneManager.h"
+#include "AllocationTracker.h"
+
+#include <cstdio>
+#include <exception>
+
+SceneManager::~SceneManager() {
+    waitForPreload();
+}
+
+void SceneManager::show(std::unique_ptr<Scene> scene) {
+    scene->preload();
+    scene->create();
+    currentScene = std::move(scene);
+}
+
+void SceneManager::load(std::unique_ptr<Scene> scene) {
+    if (pendingScene) {
+        queuedScene = std::move(scene);
+        return;
+    }
+    pendingScene = std::move(scene);
+    startPreload();
+}
+
+void SceneManager::startPreload() {
+    preloaded = false;
+    created = false;
+    preloadStart = std::chrono::steady_clock::now();
+    Scene* scene = pendingScene.get();
+    loader = std::thread([this, scene]() {
+        try {
+            scene->preload();
+        } catch (const std::exception& e) {
+            printf("Scene preload failed: %s\n", e.what());
+        }
+        preloaded = true;
+    });
+}
+
+void SceneManager::waitForPreload() {
+    if (loader.joinable())
+        loader.join();
+}
+
+bool SceneManager::update() {
+    if (!pendingScene || !preloaded)
+        return false;
+
+    if (!created) {
+        waitForPreload();
+
+        // superseded while it was loading: start over with the newer one
+        if (queuedScene) {
+            alloc::Exempt exempt;
+            pendingScene = std::move(queuedScene);
+            startPreload();
+            return false;
+        }
+
+        // a switch is a one off, not a steady state frame
+        alloc::Exempt exempt;
+        createStart = std::chrono::steady_clock::now();
+        pendingScene->create();
+        createMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - createStart).count();
+        created = true;
+    }
+
+    // keep showing the current scene while the new one's uploads are in flight
+    if (!pendingScene->ready())
+        return false;
+
+    alloc::Exempt exempt;
+    auto switched = std::chrono::steady_clock::now();
+    // the old scene's GL objects are only queued for deletion here
+    currentScene = std::move(pendingScene);
+    created = false;
+    printf("Scene switched: %.0f ms preloading in the background, %.1f ms on the GL thread, %.0f ms uploading\n",
+           std::chrono::duration<double, std::milli>(createStart - preloadStart).count(), createMilliseconds,
+           std::chrono::duration<double, std::milli>(switched - createStart).count());
+    // asked for while this one was uploading
+    if (queuedScene) {
+        pendingScene = std::move(queuedScene);
+        startPreload();
+    }
+    return true;
+}
+
+void SceneManager::clear() {
+    waitForPreload();
+    queuedScene.reset();
+    pendingScene.reset();
+    currentScene.reset();
+}
@@ -0,0 +1,70 @@
+#ifndef SCENE_MANAGER_H
+#define SCENE_MANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+/* Scene - content that can be loaded in the background and swapped in while the app keeps
+   running. preload() runs on a loading thread and does everything that needs no GL context:
+   reading files, importing models, writing texture caches, reading shader sources. create()
+   runs on the GL thread at a frame boundary and should only hand what preload prepared to the
+   UploadThread (buffers, textures, compiling programs), so the frame it runs on stays short;
+   that work is still in flight afterwards, ready() says when it has landed. */
+class Scene {
+public:
+    virtual ~Scene() {}
+
+    virtual void preload() = 0;
+    virtual void create() = 0;
+    // GL thread, after create(): whether the scene can be drawn yet
+    virtual bool ready() { return true; }
+};
+
+/* SceneManager - owns the scene being shown and the one being preloaded. The switch happens
+   in update(), between two frames; the old scene is destroyed there and its GL objects go
+   through the DeletionQueue, so they are freed once the GPU has finished with them. */
+class SceneManager {
+public:
+    SceneManager() {}
+    ~SceneManager();
+
+    SceneManager(const SceneManager&) = delete;
+    SceneManager& operator=(const SceneManager&) = delete;
+
+    // loads scene on the calling (GL) thread and shows it right away, for the first scene
+    void show(std::unique_ptr<Scene> scene);
+
+    // starts preloading scene on a loading thread, the current scene keeps being shown.
+    // A scene still preloading is dropped once it is done in favour of this one
+    void load(std::unique_ptr<Scene> scene);
+
+    // once per frame on the GL thread before the scene is used: creates the preloaded scene
+    // and switches over once it is ready, returns true if it did
+    bool update();
+
+    // destroys every scene, waiting for a preload in flight (needs the GL context)
+    void clear();
+
+    Scene* current() const { return currentScene.get(); }
+    template <typename T>
+    T* current() const { return dynamic_cast<T*>(currentScene.get()); }
+
+    bool loading() const { return pendingScene != nullptr; }
+
+private:
+    void startPreload();
+    void waitForPreload();
+
+    std::unique_ptr<Scene> currentScene;
+    std::unique_ptr<Scene> pendingScene;   // preloading on loader
+    std::unique_ptr<Scene> queuedScene;    // asked for while pendingScene was preloading
+    std::thread loader;
+    std::atomic<bool> preloaded{false};
+    bool created{false};                   // pendingScene's create() has run, waiting for ready()
+    std::chrono::steady_clock::time_point preloadStart, createStart;
+    double createMilliseconds{0.0};
+};
+
+#endif
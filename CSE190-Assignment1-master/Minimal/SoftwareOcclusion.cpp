@@ -0,0 +1,345 @@
+#include "SoftwareOcclusion.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+
+// MSVC emits AVX2 intrinsics anywhere, GCC and clang only in functions built for it
+#if defined(__GNUC__) || defined(__clang__)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+
+// Neither path may fuse a multiply and an add, or the two stop agreeing on edge pixels
+// (MSVC doesn't contract under /fp:precise)
+
+static const float FAR_DEPTH = 1.0f;
+
+bool SoftwareOcclusion::hasAvx2() {
+    static const bool supported = [] {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        // the OS has to save the upper halves of the registers on a switch too
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }();
+    return supported;
+}
+
+void SoftwareOcclusion::resize(unsigned int width, unsigned int height) {
+    tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    masks.assign((size_t)tilesX * tilesY * TILE_HEIGHT, 0u);
+    tiles.assign((size_t)tilesX * tilesY, Tile{ FAR_DEPTH, 0.0f });
+    triangles.clear();
+}
+
+void SoftwareOcclusion::setOccluders(const glm::vec4* clipVertices, const uint32_t* indices, size_t triangleCount) {
+    triangles.clear();
+    float w = (float)width(), h = (float)height();
+    for (size_t i = 0; i < triangleCount; i++) {
+        glm::vec3 v[3];
+        bool behind = false;
+        for (int corner = 0; corner < 3; corner++) {
+            const glm::vec4& clip = clipVertices[indices[i * 3 + corner]];
+            if (clip.w <= 1e-5f) {
+                behind = true;
+                break;
+            }
+            v[corner] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * w, (clip.y / clip.w * 0.5f + 0.5f) * h,
+                                  clip.z / clip.w * 0.5f + 0.5f);
+        }
+        if (behind)
+            continue;
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (area <= 0.0f)
+            continue;
+
+        float minX = std::min(v[0].x, std::min(v[1].x, v[2].x)), maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+        float minY = std::min(v[0].y, std::min(v[1].y, v[2].y)), maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+        if (maxX < 0.0f || maxY < 0.0f || minX >= w || minY >= h)
+            continue;
+
+        Triangle triangle;
+        triangle.tileX0 = (int)std::max(minX, 0.0f) / TILE_WIDTH;
+        triangle.tileY0 = (int)std::max(minY, 0.0f) / TILE_HEIGHT;
+        triangle.tileX1 = (int)std::min(maxX, w - 1.0f) / TILE_WIDTH;
+        triangle.tileY1 = (int)std::min(maxY, h - 1.0f) / TILE_HEIGHT;
+
+        // inside is left of every edge a -> b: (b - a) x (p - a) >= 0
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3& a = v[e];
+            const glm::vec3& b = v[(e + 1) % 3];
+            float dx = b.x - a.x, dy = b.y - a.y;
+            Edge& edge = triangle.edges[e];
+            if (dy == 0.0f) {
+                edge.kind = FLAT;
+                edge.slope = dx;
+                edge.offset = -dx * a.y;
+            }
+            else {
+                edge.kind = dy > 0.0f ? RIGHT : LEFT;
+                edge.slope = dx / dy;
+                edge.offset = a.x - edge.slope * a.y;
+            }
+        }
+
+        float dz1 = v[1].z - v[0].z, dz2 = v[2].z - v[0].z;
+        triangle.depthX = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) / area;
+        triangle.depthY = (dz2 * (v[1].x - v[0].x) - dz1 * (v[2].x - v[0].x)) / area;
+        triangle.depthC = v[0].z - triangle.depthX * v[0].x - triangle.depthY * v[0].y;
+        triangle.depthMax = std::max(v[0].z, std::max(v[1].z, v[2].z));
+        triangles.push_back(triangle);
+    }
+}
+
+void SoftwareOcclusion::rasterize(unsigned int firstRow, unsigned int endRow) {
+    endRow = std::min(endRow, tilesY);
+    if (firstRow >= endRow)
+        return;
+    std::fill(masks.begin() + (size_t)firstRow * tilesX * TILE_HEIGHT, masks.begin() + (size_t)endRow * tilesX * TILE_HEIGHT, 0u);
+    std::fill(tiles.begin() + (size_t)firstRow * tilesX, tiles.begin() + (size_t)endRow * tilesX, Tile{ FAR_DEPTH, 0.0f });
+    for (const Triangle& triangle : triangles) {
+        if (triangle.tileY1 < (int)firstRow || triangle.tileY0 >= (int)endRow)
+            continue;
+        if (avx2)
+            rasterizeAvx2(triangle, firstRow, endRow);
+        else
+            rasterizeScalar(triangle, firstRow, endRow);
+    }
+}
+
+bool SoftwareOcclusion::sameContents(const SoftwareOcclusion& other) const {
+    return tilesX == other.tilesX && tilesY == other.tilesY && masks == other.masks &&
+           memcmp(tiles.data(), other.tiles.data(), tiles.size() * sizeof(Tile)) == 0;
+}
+
+float SoftwareOcclusion::tileDepth(const Triangle& triangle, int tileX, int tileY) {
+    // farthest the triangle's plane gets over the tile, never beyond its farthest vertex
+    float x0 = (float)(tileX * TILE_WIDTH), x1 = (float)((tileX + 1) * TILE_WIDTH);
+    float y0 = (float)(tileY * TILE_HEIGHT), y1 = (float)((tileY + 1) * TILE_HEIGHT);
+    float x = triangle.depthX > 0.0f ? x1 : x0;
+    float y = triangle.depthY > 0.0f ? y1 : y0;
+    float z = triangle.depthX * x + triangle.depthY * y + triangle.depthC;
+    return std::max(std::min(z, triangle.depthMax), 0.0f);
+}
+
+bool SoftwareOcclusion::merge(Tile& tile, float z, bool full) {
+    // the mask just took new pixels at depth z; true when they completed it and it starts over
+    tile.zMaskFar = std::max(tile.zMaskFar, z);
+    if (!full)
+        return false;
+    tile.zFar = tile.zMaskFar;
+    tile.zMaskFar = 0.0f;
+    return true;
+}
+
+void SoftwareOcclusion::rasterizeScalar(const Triangle& triangle, unsigned int firstRow, unsigned int endRow) {
+    int rowBegin = std::max(triangle.tileY0, (int)firstRow), rowEnd = std::min(triangle.tileY1 + 1, (int)endRow);
+    for (int tileY = rowBegin; tileY < rowEnd; tileY++) {
+        float bounds[3][TILE_HEIGHT];
+        for (int e = 0; e < 3; e++)
+            for (int row = 0; row < TILE_HEIGHT; row++) {
+                float y = (float)(tileY * TILE_HEIGHT) + ((float)row + 0.5f);
+                float slopeY = triangle.edges[e].slope * y;
+                bounds[e][row] = slopeY + triangle.edges[e].offset;
+            }
+
+        for (int tileX = triangle.tileX0; tileX <= triangle.tileX1; tileX++) {
+            size_t index = (size_t)tileY * tilesX + tileX;
+            Tile& tile = tiles[index];
+            float z = tileDepth(triangle, tileX, tileY);
+            if (z >= tile.zFar)
+                continue;
+
+            float bias = (float)(tileX * TILE_WIDTH) + 0.5f;
+            uint32_t coverage[TILE_HEIGHT];
+            for (int row = 0; row < TILE_HEIGHT; row++) {
+                uint32_t bits = ~0u;
+                for (int e = 0; e < 3; e++) {
+                    float bound = bounds[e][row];
+                    switch (triangle.edges[e].kind) {
+                    case FLAT:
+                        if (!(bound >= 0.0f))
+                            bits = 0u;
+                        break;
+                    case LEFT: {
+                        int first = (int)std::ceil(std::min(std::max(bound - bias, 0.0f), 32.0f));
+                        bits &= first >= 32 ? 0u : ~0u << first;
+                        break;
+                    }
+                    default: {
+                        int end = (int)std::floor(std::min(std::max(bound - bias, -1.0f), 31.0f)) + 1;
+                        bits &= end >= 32 ? ~0u : ~(~0u << end);
+                        break;
+                    }
+                    }
+                }
+                coverage[row] = bits;
+            }
+
+            uint32_t* mask = &masks[index * TILE_HEIGHT];
+            bool grows = false, full = true;
+            for (int row = 0; row < TILE_HEIGHT; row++) {
+                grows = grows || (coverage[row] & ~mask[row]) != 0;
+                full = full && (mask[row] | coverage[row]) == ~0u;
+            }
+            if (!grows)
+                continue;
+            bool reset = merge(tile, z, full);
+            for (int row = 0; row < TILE_HEIGHT; row++)
+                mask[row] = reset ? 0u : mask[row] | coverage[row];
+        }
+    }
+}
+
+AVX2_FUNCTION
+void SoftwareOcclusion::rasterizeAvx2(const Triangle& triangle, unsigned int firstRow, unsigned int endRow) {
+    const __m256 rowCenters = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256 zero = _mm256_setzero_ps();
+    int rowBegin = std::max(triangle.tileY0, (int)firstRow), rowEnd = std::min(triangle.tileY1 + 1, (int)endRow);
+    for (int tileY = rowBegin; tileY < rowEnd; tileY++) {
+        __m256 y = _mm256_add_ps(_mm256_set1_ps((float)(tileY * TILE_HEIGHT)), rowCenters);
+        __m256 bounds[3];
+        for (int e = 0; e < 3; e++)
+            bounds[e] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.edges[e].slope), y),
+                                      _mm256_set1_ps(triangle.edges[e].offset));
+
+        for (int tileX = triangle.tileX0; tileX <= triangle.tileX1; tileX++) {
+            size_t index = (size_t)tileY * tilesX + tileX;
+            Tile& tile = tiles[index];
+            float z = tileDepth(triangle, tileX, tileY);
+            if (z >= tile.zFar)
+                continue;
+
+            __m256 bias = _mm256_set1_ps((float)(tileX * TILE_WIDTH) + 0.5f);
+            __m256i coverage = ones;
+            for (int e = 0; e < 3; e++) {
+                switch (triangle.edges[e].kind) {
+                case FLAT:
+                    coverage = _mm256_and_si256(coverage, _mm256_castps_si256(_mm256_cmp_ps(bounds[e], zero, _CMP_GE_OQ)));
+                    break;
+                case LEFT: {
+                    __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(bounds[e], bias), zero), _mm256_set1_ps(32.0f));
+                    // shifting by 32 gives 0
+                    __m256i first = _mm256_cvttps_epi32(_mm256_ceil_ps(x));
+                    coverage = _mm256_and_si256(coverage, _mm256_sllv_epi32(ones, first));
+                    break;
+                }
+                default: {
+                    __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(bounds[e], bias), _mm256_set1_ps(-1.0f)), _mm256_set1_ps(31.0f));
+                    __m256i end = _mm256_add_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(x)), _mm256_set1_epi32(1));
+                    coverage = _mm256_andnot_si256(_mm256_sllv_epi32(ones, end), coverage);
+                    break;
+                }
+                }
+            }
+
+            __m256i* mask = (__m256i*)&masks[index * TILE_HEIGHT];
+            __m256i bits = _mm256_loadu_si256(mask);
+            // nothing the mask doesn't have already
+            if (_mm256_testc_si256(bits, coverage))
+                continue;
+            bits = _mm256_or_si256(bits, coverage);
+            if (merge(tile, z, _mm256_testc_si256(bits, ones) != 0))
+                bits = _mm256_setzero_si256();
+            _mm256_storeu_si256(mask, bits);
+        }
+    }
+}
+
+SoftwareOcclusion::Result SoftwareOcclusion::test(const glm::mat4& toClip, const glm::vec3& lo, const glm::vec3& hi) const {
+    glm::vec3 ndcLo(FLT_MAX), ndcHi(-FLT_MAX);
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z, 1.0f);
+        glm::vec4 clip = toClip * corner;
+        // reaches behind the eye, no rectangle to test
+        if (clip.w <= 1e-5f)
+            return VISIBLE;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcLo = glm::min(ndcLo, ndc);
+        ndcHi = glm::max(ndcHi, ndc);
+    }
+    if (ndcHi.x < -1.0f || ndcLo.x > 1.0f || ndcHi.y < -1.0f || ndcLo.y > 1.0f || ndcLo.z > 1.0f || ndcHi.z < -1.0f)
+        return OUTSIDE;
+    if (ndcLo.z < -1.0f || tiles.empty())
+        return VISIBLE;
+
+    // every pixel the rectangle touches
+    float w = (float)width(), h = (float)height();
+    int x0 = (int)std::min(std::max((ndcLo.x * 0.5f + 0.5f) * w, 0.0f), w - 1.0f);
+    int x1 = (int)std::min(std::max((ndcHi.x * 0.5f + 0.5f) * w, 0.0f), w - 1.0f);
+    int y0 = (int)std::min(std::max((ndcLo.y * 0.5f + 0.5f) * h, 0.0f), h - 1.0f);
+    int y1 = (int)std::min(std::max((ndcHi.y * 0.5f + 0.5f) * h, 0.0f), h - 1.0f);
+    float zNear = ndcLo.z * 0.5f + 0.5f;
+    return avx2 ? testAvx2(x0, y0, x1, y1, zNear) : testScalar(x0, y0, x1, y1, zNear);
+}
+
+SoftwareOcclusion::Result SoftwareOcclusion::testScalar(int x0, int y0, int x1, int y1, float zNear) const {
+    for (int tileY = y0 / TILE_HEIGHT; tileY <= y1 / TILE_HEIGHT; tileY++)
+        for (int tileX = x0 / TILE_WIDTH; tileX <= x1 / TILE_WIDTH; tileX++) {
+            size_t index = (size_t)tileY * tilesX + tileX;
+            const Tile& tile = tiles[index];
+            // everything in the tile is nearer
+            if (tile.zFar <= zNear)
+                continue;
+            int first = std::max(x0 - tileX * TILE_WIDTH, 0), last = std::min(x1 - tileX * TILE_WIDTH, TILE_WIDTH - 1);
+            uint32_t columns = (~0u << first) & (last == 31 ? ~0u : ~(~0u << (last + 1)));
+            const uint32_t* mask = &masks[index * TILE_HEIGHT];
+            for (int row = 0; row < TILE_HEIGHT; row++) {
+                int y = tileY * TILE_HEIGHT + row;
+                if (y < y0 || y > y1)
+                    continue;
+                if ((columns & ~mask[row]) != 0 || ((columns & mask[row]) != 0 && tile.zMaskFar > zNear))
+                    return VISIBLE;
+            }
+        }
+    return OCCLUDED;
+}
+
+AVX2_FUNCTION
+SoftwareOcclusion::Result SoftwareOcclusion::testAvx2(int x0, int y0, int x1, int y1, float zNear) const {
+    const __m256i rowNumbers = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int tileY = y0 / TILE_HEIGHT; tileY <= y1 / TILE_HEIGHT; tileY++) {
+        // rows of the tile inside [y0, y1]
+        __m256i y = _mm256_add_epi32(_mm256_set1_epi32(tileY * TILE_HEIGHT), rowNumbers);
+        __m256i rows = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(y0), y),
+                                                           _mm256_cmpgt_epi32(y, _mm256_set1_epi32(y1))),
+                                           _mm256_set1_epi32(-1));
+        for (int tileX = x0 / TILE_WIDTH; tileX <= x1 / TILE_WIDTH; tileX++) {
+            size_t index = (size_t)tileY * tilesX + tileX;
+            const Tile& tile = tiles[index];
+            if (tile.zFar <= zNear)
+                continue;
+            int first = std::max(x0 - tileX * TILE_WIDTH, 0), last = std::min(x1 - tileX * TILE_WIDTH, TILE_WIDTH - 1);
+            uint32_t columns = (~0u << first) & (last == 31 ? ~0u : ~(~0u << (last + 1)));
+            __m256i rect = _mm256_and_si256(rows, _mm256_set1_epi32((int)columns));
+            __m256i mask = _mm256_loadu_si256((const __m256i*)&masks[index * TILE_HEIGHT]);
+            // pixels at the tile's depth, then pixels at the mask's
+            if (!_mm256_testc_si256(mask, rect))
+                return VISIBLE;
+            if (tile.zMaskFar > zNear && !_mm256_testz_si256(mask, rect))
+                return VISIBLE;
+        }
+    }
+    return OCCLUDED;
+}
@@ -0,0 +1,101 @@
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* SoftwareOcclusion - a small depth buffer on the CPU, for culling instances before they are
+   submitted. A few large occluders are rasterized into it, then bounding boxes are tested
+   against them; nothing touches the GPU, and the results don't depend on the thread count.
+
+   The buffer is made of 32x8 pixel tiles, stored the way masked occlusion culling does: a
+   coverage bit per pixel and two farthest depths per tile, one for the pixels whose bits
+   are set and one for the rest. An occluder triangle only adds its pixels to the mask and
+   pushes the first depth out, once the mask is full that depth becomes the tile's and the
+   mask starts over. A tile row of a triangle's coverage is eight 32-bit lanes, one per
+   pixel row, which is one AVX2 register; machines without AVX2 take a scalar path that
+   does the same float operations in the same order, so both give the same bits.
+
+   Depths are window depths (0 near, 1 far) after the usual GL projection. */
+class SoftwareOcclusion {
+public:
+    static const int TILE_WIDTH = 32;
+    static const int TILE_HEIGHT = 8;
+
+    enum Result {
+        VISIBLE,
+        OCCLUDED,
+        OUTSIDE     // not in the view at all
+    };
+
+    SoftwareOcclusion() {}
+
+    SoftwareOcclusion(const SoftwareOcclusion&) = delete;
+    SoftwareOcclusion& operator=(const SoftwareOcclusion&) = delete;
+
+    // at least width x height pixels, rounded up to whole tiles; clears the buffer
+    void resize(unsigned int width, unsigned int height);
+    unsigned int width() const { return tilesX * TILE_WIDTH; }
+    unsigned int height() const { return tilesY * TILE_HEIGHT; }
+    unsigned int tileRows() const { return tilesY; }
+
+    // sets up the occluders for the next rasterize(): indexed triangles of clip space
+    // vertices, counter-clockwise when they face the viewer. Back faces and triangles
+    // reaching behind the eye are left out, which only ever lets more through
+    void setOccluders(const glm::vec4* clipVertices, const uint32_t* indices, size_t triangleCount);
+    // clears tile rows [firstRow, endRow) and draws the occluders into them; rows are
+    // independent, so separate ranges can be rasterized on separate threads
+    void rasterize(unsigned int firstRow, unsigned int endRow);
+
+    // the box corners lo and hi in a space toClip takes to clip space; thread safe once
+    // rasterizing is done
+    Result test(const glm::mat4& toClip, const glm::vec3& lo, const glm::vec3& hi) const;
+
+    // AVX2 if the CPU (and the OS) has it, unless told not to
+    static bool hasAvx2();
+    void useAvx2(bool enable) { avx2 = enable && hasAvx2(); }
+    bool usesAvx2() const { return avx2; }
+
+    // true if other's buffer has the same size and the same coverage bits and depths, bit
+    // for bit; to check the AVX2 path against the scalar one
+    bool sameContents(const SoftwareOcclusion& other) const;
+
+private:
+    // a triangle edge as a bound on x per pixel row: x >= or <= slope * y + offset, or,
+    // with no x term, a row that is all in (offset >= 0) or all out
+    struct Edge {
+        float slope, offset;
+        int kind;           // LEFT, RIGHT, FLAT
+    };
+    enum { LEFT, RIGHT, FLAT };
+
+    struct Triangle {
+        Edge edges[3];
+        float depthX, depthY, depthC;   // window depth as a plane over pixel coordinates
+        float depthMax;                 // farthest vertex
+        int tileX0, tileY0, tileX1, tileY1;
+    };
+
+    struct Tile {
+        float zFar;         // all pixels are at most this far
+        float zMaskFar;     // pixels with their bit set are at most this far
+    };
+
+    void rasterizeScalar(const Triangle& triangle, unsigned int firstRow, unsigned int endRow);
+    void rasterizeAvx2(const Triangle& triangle, unsigned int firstRow, unsigned int endRow);
+    Result testScalar(int x0, int y0, int x1, int y1, float zNear) const;
+    Result testAvx2(int x0, int y0, int x1, int y1, float zNear) const;
+    static float tileDepth(const Triangle& triangle, int tileX, int tileY);
+    static bool merge(Tile& tile, float z, bool full);
+
+    unsigned int tilesX{0}, tilesY{0};
+    std::vector<uint32_t> masks;    // TILE_HEIGHT rows of coverage bits per tile
+    std::vector<Tile> tiles;
+    std::vector<Triangle> triangles;
+    bool avx2{hasAvx2()};
+};
+
+#endif
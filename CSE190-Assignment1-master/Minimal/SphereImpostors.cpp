@@ -0,0 +1,60 @@
+#include "SphereImpostors.h"
+#include "StreamBuffer.h"
+#include "shader.h"
+
+#include <cstdio>
+
+bool SphereImpostors::init() {
+    program_ = ProgramHandle(LoadShaders("sphere_impostor.vert", "sphere_impostor.frag"));
+    if (!program_) {
+        printf("Sphere impostors: program didn't build\n");
+        release();
+        return false;
+    }
+    highlightedLocation = glGetUniformLocation(program_.get(), "highlighted");
+    worldToModelLocation = glGetUniformLocation(program_.get(), "worldToModel");
+
+    // no vertices, the shader makes the quad's corners from gl_VertexID
+    vertexArray = VertexArrayHandle::create();
+    glBindVertexArray(vertexArray.get());
+    glEnableVertexAttribArray(SPHERE_ATTRIBUTE);
+    glVertexAttribDivisor(SPHERE_ATTRIBUTE, 1);
+    glBindVertexArray(0);
+    return true;
+}
+
+void SphereImpostors::release() {
+    program_.reset();
+    vertexArray.reset();
+}
+
+void SphereImpostors::record(DrawStream& stream, const glm::vec4* spheres, GLsizei count, bool highlighted,
+                             const glm::mat3& worldToModel, GLuint firstVisibility) {
+    DrawStream::Command command;
+    if (makeCommand(command, spheres, count, highlighted, worldToModel, firstVisibility))
+        stream.record(command);
+}
+
+bool SphereImpostors::makeCommand(DrawStream::Command& command, const glm::vec4* spheres, GLsizei count, bool highlighted,
+                                  const glm::mat3& worldToModel, GLuint firstVisibility) {
+    if (!ready() || count <= 0)
+        return false;
+    StreamBuffer::Allocation instances = StreamBuffer::instance().push(spheres, count * sizeof(glm::vec4), sizeof(glm::vec4));
+    command = DrawStream::Command();
+    command.program = program_.get();
+    command.vertexArray = vertexArray.get();
+    command.instanceBuffer = instances.buffer;
+    command.instanceOffset = instances.offset;
+    command.instanceAttribute = SPHERE_ATTRIBUTE;
+    command.instanceColumns = 1;
+    command.instanceStride = sizeof(glm::vec4);
+    command.instanceCount = count;
+    command.firstVisibility = firstVisibility;
+    command.meshCount = 0;
+    command.vertexCount = 4;
+    command.intLocation = highlightedLocation;
+    command.intValue = highlighted ? 1 : 0;
+    command.matrixLocation = worldToModelLocation;
+    command.matrixValue = worldToModel;
+    return true;
+}
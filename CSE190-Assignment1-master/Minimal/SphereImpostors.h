@@ -0,0 +1,57 @@
+#ifndef SPHERE_IMPOSTORS_H
+#define SPHERE_IMPOSTORS_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "GlHandle.h"
+#include "DrawStream.h"
+
+/* SphereImpostors - spheres drawn exactly instead of as meshes. Each sphere is one instance of
+   a four vertex quad facing the eye and just covering its silhouette; the fragment shader
+   intersects the eye ray with the sphere, discards the misses and writes the depth and normal
+   of the hit. Silhouettes and depth are exact at any distance, and a sphere costs four
+   vertices and a vec4 of instance data however close it gets.
+
+   Draws take the camera bound at CAMERA_BLOCK_BINDING like every other program, and go
+   through HiZCuller::replay like the mesh draws. */
+class SphereImpostors {
+public:
+    // per instance: world space center and radius, a vec4
+    static const GLuint SPHERE_ATTRIBUTE = 6;
+
+    SphereImpostors() {}
+
+    SphereImpostors(const SphereImpostors&) = delete;
+    SphereImpostors& operator=(const SphereImpostors&) = delete;
+
+    // GL thread; false if the program didn't build
+    bool init();
+    void release();
+    bool ready() const { return program_.get() != 0; }
+    GLuint program() const { return program_.get(); }
+
+    // records a draw of count spheres (xyz center, w radius, world space) into stream, pushing
+    // them through the stream buffer; in flat colour or, highlighted, coloured by their normal
+    // turned by worldToModel (into the model's frame, as for the mesh's normals). Occlusion
+    // culling has the spheres in its slots from firstVisibility on
+    void record(DrawStream& stream, const glm::vec4* spheres, GLsizei count, bool highlighted, const glm::mat3& worldToModel,
+                GLuint firstVisibility = 0);
+
+private:
+    bool makeCommand(DrawStream::Command& command, const glm::vec4* spheres, GLsizei count, bool highlighted,
+                     const glm::mat3& worldToModel, GLuint firstVisibility);
+
+    ProgramHandle program_;
+    VertexArrayHandle vertexArray;
+    GLint highlightedLocation{-1}, worldToModelLocation{-1};
+};
+
+#endif
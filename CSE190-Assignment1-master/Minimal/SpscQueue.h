@@ -0,0 +1,61 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/* SpscQueue - fixed-size ring for one producer thread and one consumer thread, neither ever
+   waits on a lock. Head and tail only ever grow; each side caches the other's index and only
+   reloads it when the ring looks full (or empty), so a push or pop is usually one store.
+   Capacity has to be a power of two. */
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    SpscQueue() {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer thread, false if the ring is full (the item is dropped)
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead >= Capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead >= Capacity)
+                return false;
+        }
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread, false if there is nothing to take
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return false;
+        }
+        item = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static const size_t LINE = 64;
+
+    // producer and consumer state on cache lines of their own, so neither side's stores
+    // keep invalidating the other's loads
+    std::atomic<size_t> tail{0};
+    size_t cachedHead{0};                                       // producer's copy of head
+    char producerPad[LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    std::atomic<size_t> head{0};
+    size_t cachedTail{0};                                       // consumer's copy of tail
+    char consumerPad[LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    T items[Capacity];
+};
+
+#endif
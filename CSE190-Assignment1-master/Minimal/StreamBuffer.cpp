@@ -0,0 +1,149 @@
+#include "StreamBuffer.h"
+#include "ResourceRegistry.h"
+#include "DeletionQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    const GLbitfield PERSISTENT_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    // true once the fence has passed, waits for it if wait is set
+    bool fencePassed(GLsync fence, bool wait) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            return true;
+        if (!wait)
+            return false;
+        // the first wait flushes, in case the fence is still sitting in the command queue
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        do {
+            status = glClientWaitSync(fence, flags, 1000000);   // 1 ms
+            flags = 0;
+        } while (status == GL_TIMEOUT_EXPIRED);
+        return status != GL_WAIT_FAILED;
+    }
+}
+
+StreamBuffer& StreamBuffer::instance() {
+    static StreamBuffer streamBuffer;
+    return streamBuffer;
+}
+
+void StreamBuffer::create(size_t bytesPerRegion) {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    capacity = (bytesPerRegion + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    size_t total = capacity * REGIONS;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (GLEW_ARB_buffer_storage) {
+        glBufferStorage(GL_ARRAY_BUFFER, total, nullptr, PERSISTENT_FLAGS);
+        mapped = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, total, PERSISTENT_FLAGS);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, total, nullptr, GL_DYNAMIC_DRAW);
+        mapped = nullptr;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ResourceRegistry::instance().track(ResourceKind::Buffer, buffer, total,
+                                       mapped ? "stream buffer (persistent)" : "stream buffer");
+
+    head = region * capacity;
+    end = head + capacity;
+}
+
+void StreamBuffer::beginFrame() {
+    if (!buffer)
+        create(regionSize);
+    region = (region + 1) % REGIONS;
+    if (fences[region]) {
+        if (!fencePassed(fences[region], false)) {
+            auto start = std::chrono::steady_clock::now();
+            fencePassed(fences[region], true);
+            waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            waits++;
+        }
+        glDeleteSync(fences[region]);
+        fences[region] = 0;
+    }
+    head = region * capacity;
+    end = head + capacity;
+    inFrame = true;
+    frames++;
+}
+
+void StreamBuffer::endFrame() {
+    if (!inFrame)
+        return;
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    peakBytes = std::max(peakBytes, head - region * capacity);
+    inFrame = false;
+}
+
+StreamBuffer::Allocation StreamBuffer::push(const void* data, size_t bytes, size_t alignment) {
+    if (!buffer)
+        create(regionSize);
+    size_t offset = (head + alignment - 1) / alignment * alignment;
+    if (offset + bytes > end) {
+        grow(bytes + alignment);
+        offset = (head + alignment - 1) / alignment * alignment;
+    }
+    head = offset + bytes;
+
+    if (mapped) {
+        memcpy(mapped + offset, data, bytes);
+    }
+    else {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    Allocation allocation;
+    allocation.buffer = buffer;
+    allocation.offset = (GLintptr)offset;
+    allocation.size = (GLsizeiptr)bytes;
+    return allocation;
+}
+
+StreamBuffer::Allocation StreamBuffer::pushUniform(const void* data, size_t bytes) {
+    return push(data, bytes, uniformAlignment);
+}
+
+StreamBuffer::Allocation StreamBuffer::bindUniform(GLuint binding, const void* data, size_t bytes) {
+    Allocation allocation = pushUniform(data, bytes);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, allocation.buffer, allocation.offset, allocation.size);
+    return allocation;
+}
+
+void StreamBuffer::grow(size_t bytes) {
+    // the old buffer is still read by this and earlier frames, the queue deletes it once they're done
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    DeletionQueue::instance().defer(ResourceKind::Buffer, buffer);
+    // a fresh buffer has no region in flight
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    regionSize = std::max(capacity * 2, bytes);
+    create(regionSize);
+    growths++;
+}
+
+void StreamBuffer::report(std::ostream& out) const {
+    out << "stream buffer: " << REGIONS << " x " << capacity / 1024 << " KB"
+        << (mapped ? " persistent" : " (glBufferSubData)")
+        << ", peak " << peakBytes / 1024 << " KB a frame, "
+        << waits << " fence waits in " << frames << " frames (" << waitMilliseconds << " ms), "
+        << growths << " growths" << std::endl;
+}
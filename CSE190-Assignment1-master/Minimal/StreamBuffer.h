@@ -0,0 +1,83 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/* StreamBuffer - one buffer for everything the CPU rewrites every frame: instance
+   transforms, uniform blocks, text quads. It is split into REGIONS per-frame regions;
+   the region a frame writes to is fenced at the end of the frame and only written again
+   once that fence has passed, so writes never race the GPU and the driver never has to
+   sync or orphan behind our back. With ARB_buffer_storage the buffer stays mapped
+   (persistent and coherent) and data is copied straight in, without it every push is a
+   glBufferSubData into a region the GPU is known to be done with.
+
+   A region that runs out of room is not waited on: the buffer is replaced by one twice
+   the size and the old one goes to the DeletionQueue. Bind allocation.buffer
+   every time, it is not always the same buffer. */
+class StreamBuffer {
+public:
+    static const int REGIONS = 3;
+
+    struct Allocation {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    static StreamBuffer& instance();
+
+    // bytes per region, takes effect when the buffer is (re)created
+    void setRegionSize(size_t bytes) { regionSize = bytes; }
+
+    // moves on to the next region, waiting for the GPU if it still reads from it
+    void beginFrame();
+    // fences everything pushed since beginFrame
+    void endFrame();
+
+    // copies data into this frame's region, offset is a multiple of alignment
+    Allocation push(const void* data, size_t bytes, size_t alignment = 16);
+    // same, aligned for glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+    Allocation pushUniform(const void* data, size_t bytes);
+    // pushUniform and bind the range to a uniform block binding point
+    Allocation bindUniform(GLuint binding, const void* data, size_t bytes);
+
+    bool persistent() const { return mapped != nullptr; }
+
+    // frames in which the CPU had to wait for a region's fence, and how long in total
+    unsigned int fenceWaits() const { return waits; }
+    double fenceWaitMilliseconds() const { return waitMilliseconds; }
+
+    void report(std::ostream& out) const;
+
+private:
+    StreamBuffer() {}
+
+    void create(size_t bytesPerRegion);
+    void grow(size_t bytes);
+
+    GLuint buffer{0};
+    uint8_t* mapped{nullptr};
+    size_t regionSize{4 * 1024 * 1024};
+    size_t capacity{0};               // bytes per region of the current buffer
+    GLint uniformAlignment{256};
+    int region{0};
+    size_t head{0}, end{0};           // free range of the current region
+    GLsync fences[REGIONS]{};
+    bool inFrame{false};
+
+    unsigned int frames{0}, waits{0}, growths{0};
+    double waitMilliseconds{0.0};
+    size_t peakBytes{0};
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "TextLayoutCache.h"
+#include "ResourceRegistry.h"
+
+#include <algorithm>
+#include <utility>
+
+static const GLsizei VERTICES_PER_GLYPH = 6;
+
+TextLayoutCache::TextLayoutCache(unsigned int capacityChars) : capacity(capacityChars * VERTICES_PER_GLYPH) {
+    VAO = VertexArrayHandle::create();
+    VBO = BufferHandle::create();
+    glBindVertexArray(VAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+    // allocated once, labels only ever update their own subrange
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    ResourceRegistry& registry = ResourceRegistry::instance();
+    registry.track(ResourceKind::VertexArray, VAO.get(), 0, "text layout cache VAO");
+    registry.track(ResourceKind::Buffer, VBO.get(), capacity * sizeof(glm::vec4), "text layout cache quads");
+}
+
+int TextLayoutCache::createLabel(TextRenderer* font, float size, unsigned int maxChars) {
+    GLsizei vertices = maxChars * VERTICES_PER_GLYPH;
+    if (used + vertices > capacity)
+        return -1;
+
+    Label label;
+    label.font = font;
+    label.size = size;
+    label.first = used;
+    label.capacity = vertices;
+    label.count = 0;
+    label.complete = true;
+    // room for the longest text up front, changing the text then never allocates
+    label.text.reserve(maxChars);
+    labels.push_back(std::move(label));
+    used += vertices;
+    return (int)labels.size() - 1;
+}
+
+void TextLayoutCache::setText(int index, const char* text) {
+    if (index < 0)
+        return;
+    Label& label = labels[index];
+    // same key and every glyph was there last time: nothing to do
+    if (label.complete && label.text == text)
+        return;
+
+    scratch.clear();
+    label.complete = label.font->layout(text, label.size, scratch);
+    label.text = text;
+    label.count = std::min((GLsizei)scratch.size(), label.capacity);
+
+    if (label.count > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+        glBufferSubData(GL_ARRAY_BUFFER, label.first * sizeof(glm::vec4), label.count * sizeof(glm::vec4), scratch.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    rebuildCount++;
+}
+
+void TextLayoutCache::draw(int index, const glm::mat4& transform, const glm::vec3& color) {
+    if (index < 0)
+        return;
+    const Label& label = labels[index];
+    label.font->drawQuads(VAO.get(), label.first, label.count, transform, color);
+}
@@ -0,0 +1,49 @@
+#ifndef TEXT_LAYOUT_CACHE_H
+#define TEXT_LAYOUT_CACHE_H
+
+#include "TextRenderer.h"
+
+#include <string>
+#include <vector>
+
+/* TextLayoutCache - keeps shaped text (the glyph quads) in one GPU buffer so labels
+   that rarely change, like the score and the timer, are not rebuilt every frame
+   for both eyes. Each label owns a fixed subrange of the buffer; its layout is keyed
+   by (string, font, size) and only that subrange is rewritten when the key changes. */
+class TextLayoutCache {
+public:
+    TextLayoutCache(unsigned int capacityChars = 1024);
+
+    // reserves room for maxChars glyphs, returns the label handle or -1 when the buffer is full
+    int createLabel(TextRenderer* font, float size, unsigned int maxChars);
+
+    // sets the label's text, re-shaping and re-uploading only if the text actually changed;
+    // text is copied, so frame scratch memory is fine
+    void setText(int label, const char* text);
+
+    void draw(int label, const glm::mat4& transform, const glm::vec3& color);
+
+    // how many times any label's geometry has been rebuilt, handy to check the cache works
+    unsigned int rebuilds() const { return rebuildCount; }
+
+private:
+    struct Label {
+        TextRenderer* font;
+        float         size;
+        GLint         first;    // first vertex of the label's subrange
+        GLsizei       capacity; // in vertices
+        GLsizei       count;    // vertices currently in use
+        std::string   text;     // key of the current contents, together with font and size
+        bool          complete; // false while glyphs were missing at layout time
+    };
+
+    std::vector<Label> labels;
+    std::vector<glm::vec4> scratch;
+    VertexArrayHandle VAO;
+    BufferHandle VBO;
+    GLsizei capacity;
+    GLsizei used{0};
+    unsigned int rebuildCount{0};
+};
+
+#endif
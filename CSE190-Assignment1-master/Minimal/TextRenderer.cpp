@@ -0,0 +1,440 @@
+#include "TextRenderer.h"
+#include "shader.h"
+#include "ResourceRegistry.h"
+#include "StreamBuffer.h"
+
+#include FT_OUTLINE_H
+
+#include <algorithm>
+#include <climits>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SkylinePacker
+//
+
+SkylinePacker::SkylinePacker(int width, int height) : width(width), height(height) {
+    clear();
+}
+
+void SkylinePacker::clear() {
+    skyline.clear();
+    skyline.push_back({ 0, 0, width });
+}
+
+int SkylinePacker::fit(size_t index, int w, int h) const {
+    int x = skyline[index].x;
+    if (x + w > width)
+        return -1;
+    // the rectangle rests on the highest node it spans
+    int y = 0;
+    int remaining = w;
+    while (remaining > 0) {
+        if (index == skyline.size())
+            return -1;
+        y = std::max(y, skyline[index].y);
+        if (y + h > height)
+            return -1;
+        remaining -= skyline[index].width;
+        index++;
+    }
+    return y;
+}
+
+bool SkylinePacker::pack(int w, int h, glm::ivec2& position) {
+    int bestY = INT_MAX, bestWidth = INT_MAX;
+    size_t bestIndex = skyline.size();
+    for (size_t i = 0; i < skyline.size(); i++) {
+        int y = fit(i, w, h);
+        if (y < 0)
+            continue;
+        // lowest placement wins, ties go to the narrowest segment to limit waste
+        if (y + h < bestY || (y + h == bestY && skyline[i].width < bestWidth)) {
+            bestY = y + h;
+            bestWidth = skyline[i].width;
+            bestIndex = i;
+        }
+    }
+    if (bestIndex == skyline.size())
+        return false;
+
+    position = glm::ivec2(skyline[bestIndex].x, bestY - h);
+
+    // insert the new top edge and trim whatever it now covers
+    Node node = { position.x, bestY, w };
+    skyline.insert(skyline.begin() + bestIndex, node);
+    for (size_t i = bestIndex + 1; i < skyline.size(); i++) {
+        int shadowRight = skyline[i - 1].x + skyline[i - 1].width;
+        if (skyline[i].x >= shadowRight)
+            break;
+        int shrink = shadowRight - skyline[i].x;
+        skyline[i].x += shrink;
+        skyline[i].width -= shrink;
+        if (skyline[i].width > 0)
+            break;
+        skyline.erase(skyline.begin() + i);
+        i--;
+    }
+    // merge neighbours at the same height
+    for (size_t i = 0; i + 1 < skyline.size(); i++) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+            i--;
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Signed distance field generation straight from the glyph outline
+//
+
+namespace {
+
+    struct Segment {
+        glm::vec2 a, b;
+    };
+
+    // collects the outline as line segments, curves are flattened on the way
+    struct OutlineFlattener {
+        static const int CURVE_STEPS = 8;
+
+        std::vector<Segment> segments;
+        glm::vec2 current;
+
+        static glm::vec2 toVec(const FT_Vector* v) {
+            // outline coordinates are 26.6 fixed point pixels
+            return glm::vec2(v->x / 64.0f, v->y / 64.0f);
+        }
+
+        void lineTo(const glm::vec2& to) {
+            if (to != current)
+                segments.push_back({ current, to });
+            current = to;
+        }
+
+        static int moveTo(const FT_Vector* to, void* user) {
+            OutlineFlattener* self = (OutlineFlattener*)user;
+            self->current = toVec(to);
+            return 0;
+        }
+
+        static int lineTo(const FT_Vector* to, void* user) {
+            ((OutlineFlattener*)user)->lineTo(toVec(to));
+            return 0;
+        }
+
+        static int conicTo(const FT_Vector* control, const FT_Vector* to, void* user) {
+            OutlineFlattener* self = (OutlineFlattener*)user;
+            glm::vec2 p0 = self->current, p1 = toVec(control), p2 = toVec(to);
+            for (int i = 1; i <= CURVE_STEPS; i++) {
+                float t = i / (float)CURVE_STEPS, u = 1.0f - t;
+                self->lineTo(u * u * p0 + 2.0f * u * t * p1 + t * t * p2);
+            }
+            return 0;
+        }
+
+        static int cubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user) {
+            OutlineFlattener* self = (OutlineFlattener*)user;
+            glm::vec2 p0 = self->current, p1 = toVec(control1), p2 = toVec(control2), p3 = toVec(to);
+            for (int i = 1; i <= CURVE_STEPS; i++) {
+                float t = i / (float)CURVE_STEPS, u = 1.0f - t;
+                self->lineTo(u * u * u * p0 + 3.0f * u * u * t * p1 + 3.0f * u * t * t * p2 + t * t * t * p3);
+            }
+            return 0;
+        }
+    };
+
+    float segmentDistance(const glm::vec2& p, const Segment& s) {
+        glm::vec2 ab = s.b - s.a;
+        float t = glm::dot(p - s.a, ab) / glm::dot(ab, ab);
+        t = std::min(1.0f, std::max(0.0f, t));
+        return glm::length(p - (s.a + t * ab));
+    }
+
+    // non-zero winding number of the outline around p, FreeType fills with the non-zero rule
+    int winding(const glm::vec2& p, const std::vector<Segment>& segments) {
+        int w = 0;
+        for (const Segment& s : segments) {
+            float side = (s.b.x - s.a.x) * (p.y - s.a.y) - (p.x - s.a.x) * (s.b.y - s.a.y);
+            if (s.a.y <= p.y) {
+                if (s.b.y > p.y && side > 0.0f)
+                    w++;
+            }
+            else if (s.b.y <= p.y && side < 0.0f) {
+                w--;
+            }
+        }
+        return w;
+    }
+
+}
+
+bool TextRenderer::rasterizeSdf(unsigned char c, RasterizedGlyph& glyph) {
+    // outlines only, hinting is meaningless once the glyph gets scaled
+    if (FT_Load_Char(face, c, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING))
+        return false;
+    FT_GlyphSlot slot = face->glyph;
+    glyph.advance = (GLuint)slot->advance.x;
+    if (slot->format != FT_GLYPH_FORMAT_OUTLINE)
+        return false;
+
+    OutlineFlattener flattener;
+    FT_Outline_Funcs funcs = {};
+    funcs.move_to = &OutlineFlattener::moveTo;
+    funcs.line_to = &OutlineFlattener::lineTo;
+    funcs.conic_to = &OutlineFlattener::conicTo;
+    funcs.cubic_to = &OutlineFlattener::cubicTo;
+    if (FT_Outline_Decompose(&slot->outline, &funcs, &flattener))
+        return false;
+
+    if (flattener.segments.empty()) {
+        // blank glyph (space), it only advances the pen
+        glyph.size = glm::ivec2(0);
+        glyph.bearing = glm::ivec2(0);
+        return true;
+    }
+
+    FT_BBox box;
+    FT_Outline_Get_CBox(&slot->outline, &box);
+    int left = (int)std::floor(box.xMin / 64.0f) - SDF_SPREAD;
+    int right = (int)std::ceil(box.xMax / 64.0f) + SDF_SPREAD;
+    int bottom = (int)std::floor(box.yMin / 64.0f) - SDF_SPREAD;
+    int top = (int)std::ceil(box.yMax / 64.0f) + SDF_SPREAD;
+
+    glyph.size = glm::ivec2(right - left, top - bottom);
+    glyph.bearing = glm::ivec2(left, top);
+    glyph.pixels.resize((size_t)glyph.size.x * glyph.size.y);
+
+    // 0.5 is the edge, the spread on either side maps onto [0, 1]
+    for (int row = 0; row < glyph.size.y; row++) {
+        for (int col = 0; col < glyph.size.x; col++) {
+            glm::vec2 p(left + col + 0.5f, top - row - 0.5f);
+            float d = FLT_MAX;
+            for (const Segment& s : flattener.segments)
+                d = std::min(d, segmentDistance(p, s));
+            if (winding(p, flattener.segments) == 0)
+                d = -d;
+            float v = 0.5f + 0.5f * d / SDF_SPREAD;
+            v = std::min(1.0f, std::max(0.0f, v));
+            glyph.pixels[(size_t)row * glyph.size.x + col] = (unsigned char)(v * 255.0f + 0.5f);
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TextRenderer
+//
+
+TextRenderer::TextRenderer(const std::string& fontPath, unsigned int baseSize) : packer(ATLAS_SIZE, ATLAS_SIZE) {
+    for (int i = 0; i < GLYPH_COUNT; i++)
+        glyphs[i].state = Glyph::Missing;
+
+    if (FT_Init_FreeType(&library)) {
+        std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+        library = nullptr;
+        return;
+    }
+    if (FT_New_Face(library, fontPath.c_str(), 0, &face)) {
+        std::cout << "ERROR::FREETYPE: Failed to load font " << fontPath << std::endl;
+        face = nullptr;
+        FT_Done_FreeType(library);
+        library = nullptr;
+        return;
+    }
+    FT_Set_Pixel_Sizes(face, 0, baseSize);
+
+    // single channel distance field atlas, glyphs are written into it as they come back from the worker
+    atlas = TextureHandle::create();
+    glBindTexture(GL_TEXTURE_2D, atlas.get());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // quads are streamed, draw() points attribute 0 at wherever they went this time
+    VAO = VertexArrayHandle::create();
+    glBindVertexArray(VAO.get());
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    shader = ProgramHandle(LoadShaders("shader _char.vert", "shader_char.frag"));
+    uProjection = glGetUniformLocation(shader.get(), "projection");
+    uTextColor = glGetUniformLocation(shader.get(), "textColor");
+    uText = glGetUniformLocation(shader.get(), "text");
+
+    ResourceRegistry& registry = ResourceRegistry::instance();
+    registry.track(ResourceKind::Texture, atlas.get(), ResourceRegistry::textureBytes(GL_R8, ATLAS_SIZE, ATLAS_SIZE, false),
+                   fontPath + " glyph atlas");
+    registry.track(ResourceKind::VertexArray, VAO.get(), 0, fontPath + " text VAO");
+
+    worker = std::thread(&TextRenderer::workerLoop, this);
+}
+
+TextRenderer::~TextRenderer() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+    if (face)
+        FT_Done_Face(face);
+    if (library)
+        FT_Done_FreeType(library);
+}
+
+void TextRenderer::request(unsigned char c) {
+    glyphs[c].state = Glyph::Pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(c);
+    }
+    wake.notify_one();
+}
+
+void TextRenderer::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !requests.empty(); });
+        if (stopping)
+            return;
+        unsigned char c = requests.front();
+        requests.pop_front();
+        lock.unlock();
+
+        RasterizedGlyph glyph;
+        glyph.c = c;
+        glyph.ok = rasterizeSdf(c, glyph);
+
+        lock.lock();
+        finished.push_back(std::move(glyph));
+    }
+}
+
+void TextRenderer::update() {
+    std::vector<RasterizedGlyph> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished.empty())
+            return;
+        ready.swap(finished);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, atlas.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (RasterizedGlyph& r : ready) {
+        Glyph& g = glyphs[r.c];
+        if (!r.ok) {
+            std::cout << "ERROR::FREETYPE: Failed to load Glyph " << (int)r.c << std::endl;
+            g.state = Glyph::Failed;
+            continue;
+        }
+        g.Size = r.size;
+        g.Bearing = r.bearing;
+        g.Advance = r.advance;
+
+        // one texel of padding keeps linear filtering from bleeding between glyphs
+        glm::ivec2 pos;
+        if (!packer.pack(r.size.x + 1, r.size.y + 1, pos)) {
+            std::cout << "ERROR::FREETYPE: Glyph atlas is full, dropping " << (int)r.c << std::endl;
+            g.state = Glyph::Failed;
+            continue;
+        }
+        if (r.size.x > 0 && r.size.y > 0)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, r.size.x, r.size.y, GL_RED, GL_UNSIGNED_BYTE, r.pixels.data());
+        g.uvMin = glm::vec2(pos.x, pos.y) / (float)ATLAS_SIZE;
+        g.uvMax = glm::vec2(pos.x + r.size.x, pos.y + r.size.y) / (float)ATLAS_SIZE;
+        g.state = Glyph::Ready;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool TextRenderer::layout(const char* text, float scale, std::vector<glm::vec4>& out) {
+    if (!valid())
+        return true;
+    update();
+
+    bool complete = true;
+    float x = 0.0f;
+    for (; *text; text++) {
+        unsigned char c = (unsigned char)*text;
+        if (c >= GLYPH_COUNT)
+            continue;
+        Glyph& g = glyphs[c];
+        if (g.state == Glyph::Missing)
+            request(c);
+        if (g.state == Glyph::Pending)
+            complete = false;
+        if (g.state != Glyph::Ready)
+            continue;
+
+        float xpos = x + g.Bearing.x * scale;
+        float ypos = -(g.Size.y - g.Bearing.y) * scale;
+        float w = g.Size.x * scale;
+        float h = g.Size.y * scale;
+        // atlas rows run top down, so the top of the quad samples uvMin.y
+        out.push_back(glm::vec4(xpos,     ypos + h, g.uvMin.x, g.uvMin.y));
+        out.push_back(glm::vec4(xpos,     ypos,     g.uvMin.x, g.uvMax.y));
+        out.push_back(glm::vec4(xpos + w, ypos,     g.uvMax.x, g.uvMax.y));
+        out.push_back(glm::vec4(xpos,     ypos + h, g.uvMin.x, g.uvMin.y));
+        out.push_back(glm::vec4(xpos + w, ypos,     g.uvMax.x, g.uvMax.y));
+        out.push_back(glm::vec4(xpos + w, ypos + h, g.uvMax.x, g.uvMin.y));
+
+        // advance is in 1/64 pixels
+        x += (g.Advance >> 6) * scale;
+    }
+    return complete;
+}
+
+void TextRenderer::draw(const std::string& text, const glm::mat4& transform, float scale, const glm::vec3& color) {
+    if (!valid())
+        return;
+    quads.clear();
+    layout(text.c_str(), scale, quads);
+    if (quads.empty())
+        return;
+
+    // the quads are rebuilt every call, they go through this frame's stream buffer region
+    StreamBuffer::Allocation data = StreamBuffer::instance().push(quads.data(), quads.size() * sizeof(glm::vec4), sizeof(glm::vec4));
+    glBindVertexArray(VAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, data.buffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)data.offset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    drawQuads(VAO.get(), 0, (GLsizei)quads.size(), transform, color);
+}
+
+void TextRenderer::drawQuads(GLuint vao, GLint first, GLsizei count, const glm::mat4& transform, const glm::vec3& color) {
+    if (!valid() || count == 0)
+        return;
+
+    glUseProgram(shader.get());
+    glUniformMatrix4fv(uProjection, 1, GL_FALSE, &transform[0][0]);
+    glUniform3f(uTextColor, color.x, color.y, color.z);
+    glUniform1i(uText, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas.get());
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, first, count);
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
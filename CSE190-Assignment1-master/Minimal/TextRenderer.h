@@ -0,0 +1,126 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "GlHandle.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* SkylinePacker - packs rectangles into a fixed size atlas by keeping track of the
+   "skyline" (the top edge of everything placed so far) and dropping each new
+   rectangle where it ends up lowest. */
+class SkylinePacker {
+public:
+    SkylinePacker(int width, int height);
+
+    // finds room for a w * h rectangle, returns false when the atlas is full
+    bool pack(int w, int h, glm::ivec2& position);
+    void clear();
+
+private:
+    struct Node {
+        int x, y, width;
+    };
+
+    // y at which a w * h rectangle would sit when placed on node index, or -1 if it doesn't fit
+    int fit(size_t index, int w, int h) const;
+
+    int width, height;
+    std::vector<Node> skyline;
+};
+
+/* Glyph - one character's placement in the atlas (replaces the old per glyph texture) */
+struct Glyph {
+    enum State : unsigned char { Missing, Pending, Ready, Failed };
+
+    State      state;
+    glm::ivec2 Size;       // Size of glyph in pixels
+    glm::ivec2 Bearing;    // Offset from baseline to left/top of glyph
+    GLuint     Advance;    // Offset to advance to next glyph, in 1/64 pixels
+    glm::vec2  uvMin;      // atlas rectangle, uvMin is the glyph's top left corner
+    glm::vec2  uvMax;
+};
+
+/* TextRenderer - draws strings out of a single glyph atlas. Glyphs are turned into
+   signed distance fields straight from their FreeType outlines on demand by a
+   worker thread, packed into the atlas with a skyline packer and every string is
+   drawn as one batch of quads with shader_char.frag. Since the atlas stores
+   distances rather than coverage, glyphs rendered once at baseSize stay crisp at
+   any size or viewing distance. */
+class TextRenderer {
+public:
+    static const int ATLAS_SIZE = 512;
+    static const int GLYPH_COUNT = 128; // ASCII only
+    static const int SDF_SPREAD = 4;    // distance range in pixels on each side of the edge
+
+    TextRenderer(const std::string& fontPath, unsigned int baseSize = 32);
+    ~TextRenderer();
+
+    bool valid() const { return face != nullptr; }
+
+    // draws text with its baseline starting at the origin of the x/y plane of transform,
+    // scale converts baseSize glyph pixels into transform units
+    void draw(const std::string& text, const glm::mat4& transform, float scale, const glm::vec3& color);
+
+    // uploads glyphs the worker finished since the last call, draw() does this as well
+    void update();
+
+    // shapes text into quads (6 <vec2 pos, vec2 tex> vertices per glyph) appended to out,
+    // returns false while some of its glyphs are still being rasterized
+    bool layout(const char* text, float scale, std::vector<glm::vec4>& out);
+    // draws count vertices starting at first out of a VAO laid out like the one above
+    void drawQuads(GLuint vao, GLint first, GLsizei count, const glm::mat4& transform, const glm::vec3& color);
+
+private:
+    struct RasterizedGlyph {
+        unsigned char c;
+        bool ok;
+        glm::ivec2 size, bearing;
+        GLuint advance;
+        std::vector<unsigned char> pixels;
+    };
+
+    void request(unsigned char c);
+    bool rasterizeSdf(unsigned char c, RasterizedGlyph& glyph);
+    void workerLoop();
+
+    // flat lookup table indexed by character code
+    Glyph glyphs[GLYPH_COUNT];
+
+    SkylinePacker packer;
+    TextureHandle atlas;
+    VertexArrayHandle VAO;
+    ProgramHandle shader;
+    GLint uProjection{-1}, uTextColor{-1}, uText{-1};
+    std::vector<glm::vec4> quads; // <vec2 pos, vec2 tex>, kept around to reuse its storage
+
+    // FreeType objects, only touched by the worker once it is running
+    FT_Library library{nullptr};
+    FT_Face face{nullptr};
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<unsigned char> requests;
+    std::vector<RasterizedGlyph> finished;
+    bool stopping{false};
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "TextureCompression.h"
+#include "MipGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    uint16_t pack565(const float c[3]) {
+        int r = (int)(std::min(255.0f, std::max(0.0f, c[0])) * 31.0f / 255.0f + 0.5f);
+        int g = (int)(std::min(255.0f, std::max(0.0f, c[1])) * 63.0f / 255.0f + 0.5f);
+        int b = (int)(std::min(255.0f, std::max(0.0f, c[2])) * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    void unpack565(uint16_t c, int out[3]) {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        out[0] = (r << 3) | (r >> 2);
+        out[1] = (g << 2) | (g >> 4);
+        out[2] = (b << 3) | (b >> 2);
+    }
+
+    void write16(uint8_t* out, uint16_t v) {
+        out[0] = (uint8_t)(v & 0xFF);
+        out[1] = (uint8_t)(v >> 8);
+    }
+}
+
+namespace bc
+{
+    BlockFormat formatForChannels(int channels) {
+        switch (channels) {
+        case 1:  return BlockFormat::BC4;
+        case 2:  return BlockFormat::BC5;
+        case 3:  return BlockFormat::BC1;
+        default: return BlockFormat::BC3;
+        }
+    }
+
+    size_t blockBytes(BlockFormat format) {
+        return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+    }
+
+    size_t levelBytes(BlockFormat format, int width, int height) {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+    }
+
+    void encodeBC1(const uint8_t rgba[16 * 4], uint8_t out[8]) {
+        // principal axis of the block's colors, found by a few rounds of power iteration
+        float mean[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += rgba[i * 4 + c] / 16.0f;
+
+        float cov[6] = { 0, 0, 0, 0, 0, 0 };
+        for (int i = 0; i < 16; i++) {
+            float r = rgba[i * 4] - mean[0], g = rgba[i * 4 + 1] - mean[1], b = rgba[i * 4 + 2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+
+        float axis[3] = { 0.9f, 1.0f, 0.7f };
+        for (int iter = 0; iter < 4; iter++) {
+            float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+            float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+            float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+            float len = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if (len < 1e-6f)
+                break; // flat block, any axis will do
+            axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+        }
+
+        // the extreme texels along that axis become the end points
+        int minIndex = 0, maxIndex = 0;
+        float minDot = 1e30f, maxDot = -1e30f;
+        for (int i = 0; i < 16; i++) {
+            float d = rgba[i * 4] * axis[0] + rgba[i * 4 + 1] * axis[1] + rgba[i * 4 + 2] * axis[2];
+            if (d < minDot) { minDot = d; minIndex = i; }
+            if (d > maxDot) { maxDot = d; maxIndex = i; }
+        }
+        float maxColor[3], minColor[3];
+        for (int c = 0; c < 3; c++) {
+            maxColor[c] = rgba[maxIndex * 4 + c];
+            minColor[c] = rgba[minIndex * 4 + c];
+        }
+
+        uint16_t c0 = pack565(maxColor), c1 = pack565(minColor);
+        // c0 > c1 selects the 4 color mode, which is the only one BC3 knows about
+        if (c0 < c1)
+            std::swap(c0, c1);
+        write16(out, c0);
+        write16(out + 2, c1);
+
+        uint32_t indices = 0;
+        if (c0 != c1) {
+            int palette[4][3];
+            unpack565(c0, palette[0]);
+            unpack565(c1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++) {
+                int best = 0, bestError = INT32_MAX;
+                for (int p = 0; p < 4; p++) {
+                    int dr = rgba[i * 4] - palette[p][0], dg = rgba[i * 4 + 1] - palette[p][1], db = rgba[i * 4 + 2] - palette[p][2];
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError) { bestError = error; best = p; }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+        write16(out + 4, (uint16_t)(indices & 0xFFFF));
+        write16(out + 6, (uint16_t)(indices >> 16));
+    }
+
+    void encodeBC4(const uint8_t values[16], uint8_t out[8]) {
+        uint8_t lo = 255, hi = 0;
+        for (int i = 0; i < 16; i++) {
+            lo = std::min(lo, values[i]);
+            hi = std::max(hi, values[i]);
+        }
+        // a0 > a1 selects the 8 value mode
+        out[0] = hi;
+        out[1] = lo;
+
+        uint64_t indices = 0;
+        if (hi != lo) {
+            for (int i = 0; i < 16; i++) {
+                // position on the ramp from lo (0) to hi (7)
+                int p = ((values[i] - lo) * 14 + (hi - lo)) / (2 * (hi - lo));
+                int index = p == 7 ? 0 : p == 0 ? 1 : 8 - p;
+                indices |= (uint64_t)index << (3 * i);
+            }
+        }
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (uint8_t)(indices >> (8 * i));
+    }
+
+    void encodeBC3(const uint8_t rgba[16 * 4], uint8_t out[16]) {
+        uint8_t alpha[16];
+        for (int i = 0; i < 16; i++)
+            alpha[i] = rgba[i * 4 + 3];
+        encodeBC4(alpha, out);
+        encodeBC1(rgba, out + 8);
+    }
+
+    void encodeBC5(const uint8_t red[16], const uint8_t green[16], uint8_t out[16]) {
+        encodeBC4(red, out);
+        encodeBC4(green, out + 8);
+    }
+
+    std::vector<uint8_t> compressLevel(const uint8_t* pixels, int width, int height, int channels, BlockFormat format,
+                                       JobSystem* jobs) {
+        std::vector<uint8_t> out(levelBytes(format, width, height));
+        size_t stride = blockBytes(format);
+        int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+
+        // block rows are independent, hand them out in chunks of about 256 blocks
+        auto compressRows = [&](size_t begin, size_t end) {
+            uint8_t* dst = out.data() + begin * blocksWide * stride;
+            for (int by = (int)begin * 4; by < (int)end * 4; by += 4) {
+                for (int bx = 0; bx < width; bx += 4) {
+                    // gather the block as RGBA8, blocks hanging over the edge repeat the last texel
+                    uint8_t rgba[16 * 4];
+                    for (int i = 0; i < 16; i++) {
+                        int x = std::min(bx + (i & 3), width - 1);
+                        int y = std::min(by + (i >> 2), height - 1);
+                        const uint8_t* src = pixels + ((size_t)y * width + x) * channels;
+                        rgba[i * 4 + 0] = src[0];
+                        rgba[i * 4 + 1] = channels > 1 ? src[1] : src[0];
+                        rgba[i * 4 + 2] = channels > 2 ? src[2] : src[0];
+                        rgba[i * 4 + 3] = channels > 3 ? src[3] : 255;
+                    }
+
+                    switch (format) {
+                    case BlockFormat::BC1:
+                        encodeBC1(rgba, dst);
+                        break;
+                    case BlockFormat::BC3:
+                        encodeBC3(rgba, dst);
+                        break;
+                    case BlockFormat::BC4: {
+                        uint8_t red[16];
+                        for (int i = 0; i < 16; i++)
+                            red[i] = rgba[i * 4];
+                        encodeBC4(red, dst);
+                        break;
+                    }
+                    case BlockFormat::BC5: {
+                        uint8_t red[16], green[16];
+                        for (int i = 0; i < 16; i++) {
+                            red[i] = rgba[i * 4];
+                            green[i] = rgba[i * 4 + 1];
+                        }
+                        encodeBC5(red, green, dst);
+                        break;
+                    }
+                    }
+                    dst += stride;
+                }
+            }
+        };
+        size_t grain = std::max(1, 256 / blocksWide);
+        if (jobs)
+            jobs->parallelFor(blocksHigh, grain, compressRows);
+        else
+            compressRows(0, blocksHigh);
+        return out;
+    }
+
+    CompressedImage compress(const uint8_t* pixels, int width, int height, int channels, bool srgb) {
+        JobSystem& jobs = JobSystem::instance();
+        mip::Chain chain = mip::generate(mip::Image(pixels, width, height, channels), srgb, &jobs);
+
+        CompressedImage image;
+        image.format = formatForChannels(channels);
+        image.srgb = chain.srgb;
+        image.width = width;
+        image.height = height;
+        image.levels.resize(chain.levels.size());
+        for (size_t level = 0; level < chain.levels.size(); level++) {
+            int w = std::max(1, width >> level), h = std::max(1, height >> level);
+            image.levels[level] = compressLevel(chain.levels[level].data(), w, h, channels, image.format, &jobs);
+        }
+        return image;
+    }
+}
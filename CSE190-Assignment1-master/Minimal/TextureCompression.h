@@ -0,0 +1,50 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Block compressed formats the transcoder can produce. All of them work on 4x4 texel blocks.
+enum class BlockFormat {
+    BC1, // RGB, 8 bytes per block
+    BC3, // RGBA, 16 bytes per block
+    BC4, // single channel, 8 bytes per block
+    BC5  // two channels, 16 bytes per block
+};
+
+/* A mip chain of block compressed data, level 0 first */
+struct CompressedImage {
+    BlockFormat format;
+    bool srgb;          // BC1 / BC3 colour is sRGB encoded
+    int width, height;
+    std::vector<std::vector<uint8_t>> levels;
+};
+
+namespace bc
+{
+    // picks the block format for an image with the given channel count (as returned by stbi_load)
+    BlockFormat formatForChannels(int channels);
+
+    size_t blockBytes(BlockFormat format);
+    size_t levelBytes(BlockFormat format, int width, int height);
+
+    // single 4x4 block encoders, input texels are RGBA8 / 8 bit values in row order
+    void encodeBC1(const uint8_t rgba[16 * 4], uint8_t out[8]);
+    void encodeBC3(const uint8_t rgba[16 * 4], uint8_t out[16]);
+    void encodeBC4(const uint8_t values[16], uint8_t out[8]);
+    void encodeBC5(const uint8_t red[16], const uint8_t green[16], uint8_t out[16]);
+
+    // compresses one level; pixels are tightly packed with the given channel count.
+    // With jobs, rows of blocks are compressed in parallel
+    std::vector<uint8_t> compressLevel(const uint8_t* pixels, int width, int height, int channels, BlockFormat format,
+                                       JobSystem* jobs = nullptr);
+
+    // builds the full mip chain with mip::generate (in linear light for srgb colour images)
+    // and compresses every level of it, all as jobs
+    CompressedImage compress(const uint8_t* pixels, int width, int height, int channels, bool srgb = false);
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include "TextureStreamer.h"
+#include "ResourceRegistry.h"
+#include "DeletionQueue.h"
+
+#include <algorithm>
+#include <cmath>
+
+TextureStreamer::TextureStreamer() {
+    DeletionQueue::instance().addListener([this](ResourceKind kind, GLuint id) {
+        if (kind == ResourceKind::Texture)
+            forget(id);
+    });
+}
+
+TextureStreamer& TextureStreamer::instance() {
+    static TextureStreamer streamer;
+    return streamer;
+}
+
+void TextureStreamer::forget(GLuint texture) {
+    auto it = textures.find(texture);
+    if (it == textures.end())
+        return;
+    resident -= it->second.bytes;
+    bool uploading = it->second.uploading;
+    UploadThread::Ticket ticket = it->second.ticket;
+    textures.erase(it);
+    // the name is deleted a few frames from now, the upload has to be done with it by then;
+    // its completion finds the texture gone and does nothing
+    if (uploading)
+        UploadThread::instance().wait(ticket);
+}
+
+bool TextureStreamer::load(GLuint texture, const std::string& path) {
+    StreamedTexture t;
+    t.source = std::make_shared<Source>();
+    t.source->file = std::make_unique<MappedFile>(path);
+    const MappedFile& file = *t.source->file;
+    if (!file.valid() || !ktx2::parse(file.data(), file.size(), t.source->view))
+        return false;
+    t.path = path;
+    t.bytes = 0;
+    t.uploading = false;
+    t.ticket = 0;
+
+    // the tail is every level that fits in TAIL_SIZE, never less than the last level
+    int levels = (int)t.source->view.levels.size();
+    t.tailLevel = levels - 1;
+    for (int level = 0; level < levels; level++) {
+        if (std::max(t.source->view.width >> level, t.source->view.height >> level) <= TAIL_SIZE) {
+            t.tailLevel = level;
+            break;
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int level = levels - 1; level >= t.tailLevel; level--)
+        uploadLevel(texture, t, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    t.wantedLevel = t.tailLevel;
+    t.lastUsed = frame;
+    ResourceRegistry::instance().track(ResourceKind::Texture, texture, t.bytes, path + " (streamed)");
+    textures[texture] = std::move(t);
+    return true;
+}
+
+void TextureStreamer::request(GLuint texture, float screenPixels) {
+    auto it = textures.find(texture);
+    if (it == textures.end())
+        return;
+    StreamedTexture& t = it->second;
+
+    // finest level whose size doesn't exceed what the screen can show
+    int size = std::max(t.source->view.width, t.source->view.height);
+    int level = 0;
+    if (screenPixels >= 1.0f && size > screenPixels)
+        level = (int)std::floor(std::log2(size / screenPixels));
+    else if (screenPixels < 1.0f)
+        level = t.tailLevel;
+    t.wantedLevel = std::min(t.wantedLevel, std::min(level, t.tailLevel));
+    t.lastUsed = frame;
+}
+
+void TextureStreamer::uploadLevel(GLuint texture, StreamedTexture& t, int level) {
+    // expects texture to be bound
+    const ktx2::ImageView::Level& data = t.source->view.levels[level];
+    int w = std::max(1, t.source->view.width >> level), h = std::max(1, t.source->view.height >> level);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx2::glFormat(t.source->view.format, t.source->view.srgb), w, h, 0, (GLsizei)data.size, data.data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    t.baseLevel = level;
+    t.bytes += data.size;
+    resident += data.size;
+}
+
+void TextureStreamer::streamLevels(GLuint texture, StreamedTexture& t) {
+    // levels baseLevel - 1 down to targetLevel in one upload; sampling stays on the old
+    // base level until the completion moves it
+    std::shared_ptr<Source> source = t.source;
+    int from = t.baseLevel - 1, to = t.targetLevel;
+    size_t bytes = 0;
+    for (int level = from; level >= to; level--)
+        bytes += source->view.levels[level].size;
+    t.uploading = true;
+    t.ticket = UploadThread::instance().submit(
+        [source, texture, from, to] {
+            const ktx2::ImageView& view = source->view;
+            GLenum format = ktx2::glFormat(view.format, view.srgb);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            for (int level = from; level >= to; level--) {
+                int w = std::max(1, view.width >> level), h = std::max(1, view.height >> level);
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, format, w, h, 0, (GLsizei)view.levels[level].size, view.levels[level].data);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+        },
+        [this, source, texture, to, bytes] { finishStreaming(texture, source, to, bytes); });
+}
+
+void TextureStreamer::finishStreaming(GLuint texture, const std::shared_ptr<Source>& source, int level, size_t bytes) {
+    // forgotten while uploading, and maybe the name reused by another texture since
+    auto it = textures.find(texture);
+    if (it == textures.end() || it->second.source != source)
+        return;
+    StreamedTexture& t = it->second;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    t.baseLevel = level;
+    t.uploading = false;
+    t.bytes += bytes;
+    resident += bytes;
+    ResourceRegistry::instance().resize(ResourceKind::Texture, texture, t.bytes);
+}
+
+void TextureStreamer::evictLevel(GLuint texture, StreamedTexture& t) {
+    int level = t.baseLevel;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // move sampling off the level first, then respecify it empty so the driver can release it
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, ktx2::glFormat(t.source->view.format, t.source->view.srgb), 0, 0, 0, 0, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    t.baseLevel = level + 1;
+    t.bytes -= t.source->view.levels[level].size;
+    resident -= t.source->view.levels[level].size;
+}
+
+void TextureStreamer::update(unsigned int currentFrame) {
+    // plan coarse to fine, one level per texture per round so nobody starves; textures
+    // with levels still in flight wait for them to land
+    for (auto& entry : textures)
+        entry.second.targetLevel = entry.second.baseLevel;
+    size_t uploaded = 0;
+    bool progress = true;
+    while (progress && uploaded < uploadBudget) {
+        progress = false;
+        for (auto& entry : textures) {
+            StreamedTexture& t = entry.second;
+            if (t.uploading || t.wantedLevel >= t.targetLevel || uploaded >= uploadBudget)
+                continue;
+            t.targetLevel--;
+            uploaded += t.source->view.levels[t.targetLevel].size;
+            progress = true;
+        }
+    }
+    // then hand each texture's levels to the upload thread in one go
+    for (auto& entry : textures) {
+        StreamedTexture& t = entry.second;
+        if (!t.uploading && t.targetLevel < t.baseLevel)
+            streamLevels(entry.first, t);
+    }
+
+    // over budget: drop the finest level of the least recently used texture until we fit,
+    // textures holding more detail than they asked for go first among equals
+    while (resident > budget) {
+        GLuint victim = 0;
+        StreamedTexture* worst = nullptr;
+        for (auto& entry : textures) {
+            StreamedTexture& t = entry.second;
+            if (t.uploading || t.baseLevel >= t.tailLevel)
+                continue;
+            bool surplus = t.baseLevel < t.wantedLevel;
+            if (!worst || t.lastUsed < worst->lastUsed ||
+                (t.lastUsed == worst->lastUsed && surplus && !(worst->baseLevel < worst->wantedLevel))) {
+                worst = &t;
+                victim = entry.first;
+            }
+        }
+        if (!worst)
+            break;
+        evictLevel(victim, *worst);
+        ResourceRegistry::instance().resize(ResourceKind::Texture, victim, worst->bytes);
+    }
+
+    // requests made while drawing this frame decide what the next update streams
+    for (auto& entry : textures)
+        entry.second.wantedLevel = entry.second.tailLevel;
+    frame = currentFrame;
+}
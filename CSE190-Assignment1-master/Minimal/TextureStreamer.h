@@ -0,0 +1,84 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include "Ktx2.h"
+#include "MappedFile.h"
+#include "UploadThread.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+/* TextureStreamer - keeps KTX2 textures only as resident as they need to be. A texture
+   starts out with just its low resolution mip tail; meshes report how large it shows up
+   on screen and finer levels are streamed in a few per frame (GL_TEXTURE_BASE_LEVEL moves
+   down as they arrive). When the VRAM budget is exceeded the finest levels of the least
+   recently used textures are dropped again. Level data comes straight out of a mapping
+   of the KTX2 file, nothing but the GL copy is kept in memory.
+
+   Streamed levels go up on the UploadThread; the base level only moves once the fence says
+   they have arrived. The mip tail uploads on the calling thread, it is needed right away. */
+class TextureStreamer {
+public:
+    static const int TAIL_SIZE = 64; // levels this size and below are always resident
+
+    static TextureStreamer& instance();
+
+    void setBudget(size_t bytes) { budget = bytes; }
+    void setUploadBudgetPerFrame(size_t bytes) { uploadBudget = bytes; }
+    void setViewportHeight(int pixels) { viewportHeight = pixels; }
+    int getViewportHeight() const { return viewportHeight; }
+
+    // starts streaming texture out of the KTX2 file at path, uploads the mip tail right away
+    bool load(GLuint texture, const std::string& path);
+    bool streamed(GLuint texture) const { return textures.count(texture) != 0; }
+
+    // texture was drawn this frame covering about screenPixels along its larger axis
+    void request(GLuint texture, float screenPixels);
+
+    // stops streaming a texture that is about to be deleted (the DeletionQueue calls this)
+    void forget(GLuint texture);
+
+    // once per frame: starts uploading requested levels within the per frame budget and
+    // evicts least recently used levels while over the VRAM budget
+    void update(unsigned int frame);
+
+    size_t residentBytes() const { return resident; }
+
+private:
+    // the mapping and what was parsed out of it, shared with uploads in flight so a texture
+    // forgotten meanwhile doesn't unmap what they read
+    struct Source {
+        std::unique_ptr<MappedFile> file;
+        ktx2::ImageView view;
+    };
+
+    struct StreamedTexture {
+        std::shared_ptr<Source> source;
+        std::string path;
+        int tailLevel;     // coarsest level that is always resident
+        int baseLevel;     // finest level currently resident
+        int wantedLevel;   // finest level requested since the last update
+        unsigned int lastUsed;
+        int targetLevel;   // finest level this update's budget allows
+        size_t bytes;      // resident bytes
+        bool uploading;    // levels in flight on the upload thread, base level not moved yet
+        UploadThread::Ticket ticket;
+    };
+
+    TextureStreamer();
+
+    void uploadLevel(GLuint texture, StreamedTexture& t, int level);
+    void streamLevels(GLuint texture, StreamedTexture& t);
+    void finishStreaming(GLuint texture, const std::shared_ptr<Source>& source, int level, size_t bytes);
+    void evictLevel(GLuint texture, StreamedTexture& t);
+
+    std::map<GLuint, StreamedTexture> textures;
+    size_t budget{256 * 1024 * 1024};
+    size_t uploadBudget{4 * 1024 * 1024};
+    size_t resident{0};
+    int viewportHeight{1024};
+    unsigned int frame{0};
+};
+
+#endif
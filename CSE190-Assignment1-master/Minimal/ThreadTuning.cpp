@@ -0,0 +1,78 @@
+#include "ThreadTuning.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace threading
+{
+    bool pinToCpu(int cpu) {
+        if (cpu < 0)
+            return false;
+#ifdef _WIN32
+        if (cpu >= (int)(sizeof(DWORD_PTR) * 8))
+            return false;
+        return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+        if (cpu >= CPU_SETSIZE)
+            return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        return false;
+#endif
+    }
+
+    bool raisePriority() {
+#ifdef _WIN32
+        return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST) != 0;
+#elif defined(__linux__)
+        // low in the real-time range: above every normal thread, below the system's own
+        sched_param param;
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 9;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+            return true;
+        // nice values are per thread on Linux, addressed by thread id
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+        return setpriority(PRIO_PROCESS, tid, -10) == 0;
+#else
+        return false;
+#endif
+    }
+
+    bool raiseTimerResolution() {
+#ifdef _WIN32
+        return timeBeginPeriod(1) == TIMERR_NOERROR;
+#else
+        return true;
+#endif
+    }
+
+    void restoreTimerResolution() {
+#ifdef _WIN32
+        timeEndPeriod(1);
+#endif
+    }
+
+    void setName(const char* name) {
+#ifdef __linux__
+        char shortName[16];   // the kernel keeps 15 characters
+        snprintf(shortName, sizeof(shortName), "%s", name);
+        pthread_setname_np(pthread_self(), shortName);
+#else
+        (void)name;
+#endif
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef THREAD_TUNING_H
+#define THREAD_TUNING_H
+
+/* Scheduling knobs for latency sensitive threads, the render thread in particular. They
+   act on the calling thread and are best effort: when the OS or the user's rights don't
+   allow it they return false and leave the thread as it was. */
+namespace threading
+{
+    // restricts the calling thread to one logical CPU
+    bool pinToCpu(int cpu);
+
+    // Linux: SCHED_FIFO when permitted (root, CAP_SYS_NICE or an rtprio limit), otherwise a
+    // lower nice value for just this thread. Windows: THREAD_PRIORITY_HIGHEST.
+    bool raisePriority();
+
+    // Windows: sleeps wake within about a millisecond instead of the default ~15 ms tick, for
+    // threads that sleep until deadlines a few milliseconds apart. Nothing to do elsewhere.
+    // Every call needs a restoreTimerResolution
+    bool raiseTimerResolution();
+    void restoreTimerResolution();
+
+    // shows up in debuggers and top -H, Linux only
+    void setName(const char* name);
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/* TripleBuffer - hands snapshots from one writer thread to one reader thread without
+   either ever waiting on the other. The writer fills write() and publishes it; the reader
+   picks up the newest published snapshot with acquire() and keeps reading it until the
+   next acquire. Snapshots the reader never got to are simply overwritten.
+
+   The slot write() returns after publish holds an old snapshot, so the writer has to fill
+   it completely every time. */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer thread
+    T& write() { return slots[writeIndex]; }
+    void publish() {
+        writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // reader thread: switches to the newest snapshot, returns false if nothing new was published
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& read() const { return slots[readIndex]; }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    T slots[3];
+    unsigned int writeIndex{0};
+    unsigned int readIndex{1};
+    std::atomic<unsigned int> middle{2};   // slot between the two, FRESH if published but not read
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "UploadThread.h"
+#include "ThreadTuning.h"
+
+#include <chrono>
+#include <cstdio>
+
+UploadThread& UploadThread::instance() {
+    static UploadThread uploader;
+    return uploader;
+}
+
+UploadThread::~UploadThread() {
+    // stop() should have run while the windows were still around, just don't leave a thread behind
+    if (thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+}
+
+bool UploadThread::start(GLFWwindow* mainWindow) {
+    if (thread.joinable())
+        return true;
+    // same context hints as the main window, just never shown
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    window = glfwCreateWindow(1, 1, "upload", nullptr, mainWindow);
+    glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+    if (!window) {
+        printf("No shared upload context, uploading on the render thread\n");
+        return false;
+    }
+    shared = true;
+    stopping = false;
+    thread = std::thread(&UploadThread::run, this);
+    return true;
+}
+
+void UploadThread::stop() {
+    if (!thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    glfwDestroyWindow(window);
+    window = nullptr;
+    while (completed + 1 < nextTicket)
+        retire(true);
+}
+
+UploadThread::Ticket UploadThread::submitTask(std::function<void()> upload, std::function<void()> complete) {
+    Ticket ticket = nextTicket++;
+    if (!thread.joinable()) {
+        upload();
+        complete();
+        completed = ticket;
+        return ticket;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(Task{ticket, std::move(upload), std::move(complete), nullptr});
+    }
+    wake.notify_one();
+    return ticket;
+}
+
+void UploadThread::run() {
+    glfwMakeContextCurrent(window);
+    threading::setName("upload");
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (queued.empty())
+                break;
+            task = std::move(queued.front());
+            queued.pop_front();
+        }
+        auto start = std::chrono::steady_clock::now();
+        task.upload();
+        // flushed, or the render context could wait on a fence that was never submitted
+        task.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads++;
+        uploadMilliseconds += milliseconds;
+        fenced.push_back(std::move(task));
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+void UploadThread::retire(bool block) {
+    // only this thread takes tasks off fenced, the front stays put while we wait on it unlocked
+    while (true) {
+        GLsync fence;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (fenced.empty())
+                return;
+            fence = fenced.front().fence;
+        }
+        GLenum status = block ? glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull)
+                              : glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return;
+
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = std::move(fenced.front());
+            fenced.pop_front();
+        }
+        glDeleteSync(task.fence);
+        // the data is there, binding the objects in this context from now on sees it
+        task.complete();
+        completed = task.ticket;
+    }
+}
+
+void UploadThread::update() {
+    retire(false);
+}
+
+void UploadThread::wait(Ticket ticket) {
+    while (!done(ticket)) {
+        retire(true);
+        if (!done(ticket))
+            std::this_thread::yield();
+    }
+}
+
+void UploadThread::report(std::ostream& out) const {
+    char line[160];
+    snprintf(line, sizeof(line), "upload thread: %s, %llu uploads, %.1f ms spent off the render thread",
+             shared ? "shared context" : "off", (unsigned long long)uploads, uploadMilliseconds);
+    out << line << std::endl;
+}
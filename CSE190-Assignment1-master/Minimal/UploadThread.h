@@ -0,0 +1,97 @@
+#ifndef UPLOAD_THREAD_H
+#define UPLOAD_THREAD_H
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <utility>
+
+#include "AllocationTracker.h"
+
+/* UploadThread - a second GL context, on a hidden window sharing its objects with the main
+   one, whose thread does the big buffer and texture uploads so they don't take frame time.
+   Every upload is followed by a glFenceSync; the render thread polls those fences once a
+   frame (never blocking) and only then runs the upload's completion and lets its objects
+   be used. Container objects (VAOs, FBOs) aren't shared between contexts, so they are
+   still set up on the render thread, once the data they point at has arrived.
+
+   Until start() succeeds, and after stop(), uploads run right away on the calling thread,
+   which then needs the context. */
+class UploadThread {
+public:
+    typedef uint64_t Ticket;
+
+    static UploadThread& instance();
+
+    // main thread, once the main window exists and its context is current
+    bool start(GLFWwindow* mainWindow);
+    // main thread, before the main window goes: finishes every upload and completion (needs the main context)
+    void stop();
+    bool running() const { return thread.joinable(); }
+
+    // upload runs on the upload thread with its own context and may only touch buffers, textures
+    // and programs (the objects both contexts share); what it reads has to stay alive until the
+    // ticket is done. complete then runs on the render thread, in update(), after the GPU has the data
+    template <typename Upload, typename Complete>
+    Ticket submit(Upload&& upload, Complete&& complete);
+    template <typename Upload>
+    Ticket submit(Upload&& upload) { return submit(std::forward<Upload>(upload), [] {}); }
+
+    // render thread, once a frame: checks the fences, runs completions in submission order
+    void update();
+
+    // render thread
+    bool done(Ticket ticket) const { return ticket <= completed; }
+    void wait(Ticket ticket);
+
+    void report(std::ostream& out) const;
+
+private:
+    struct Task {
+        Ticket ticket;
+        std::function<void()> upload, complete;
+        GLsync fence;
+    };
+
+    UploadThread() {}
+    ~UploadThread();
+
+    Ticket submitTask(std::function<void()> upload, std::function<void()> complete);
+    void run();
+    void retire(bool block);
+
+    GLFWwindow* window{nullptr};
+    bool shared{false};        // a shared context was made at some point, for the report
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Task> queued;   // waiting for the upload thread
+    std::deque<Task> fenced;   // uploaded, waiting for their fence
+    bool stopping{false};
+    Ticket nextTicket{1};
+    Ticket completed{0};
+
+    uint64_t uploads{0};
+    double uploadMilliseconds{0.0};   // spent on the upload thread
+};
+
+template <typename Upload, typename Complete>
+UploadThread::Ticket UploadThread::submit(Upload&& upload, Complete&& complete) {
+    // an upload is an event, not part of a steady-state frame
+    alloc::Exempt exempt;
+    return submitTask(std::function<void()>(std::forward<Upload>(upload)), std::function<void()>(std::forward<Complete>(complete)));
+}
+
+#endif
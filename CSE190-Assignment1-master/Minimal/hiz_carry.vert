@@ -0,0 +1,18 @@
+#version 410 core
+// Occlusion culling, before the first phase: brings last frame's visibility into this
+// frame's draw order. One point per instance, captured with transform feedback.
+
+// where the instance was drawn last frame, 0xffffffff if it wasn't
+layout (location = 0) in uint previousSlot;
+
+// last frame's visibility, bit 0 set for instances that were visible
+uniform usamplerBuffer previousVisibility;
+
+// bit 1: visible last frame, drawn in the first phase
+flat out uint visibility;
+
+void main()
+{
+    uint wasVisible = previousSlot == 0xffffffffu ? 1u : texelFetch(previousVisibility, int(previousSlot)).r & 1u;
+    visibility = wasVisible << 1;
+}
@@ -0,0 +1,30 @@
+#version 410 core
+// Occlusion culling, before a phase's draws: copies the instances the phase draws, in order and
+// nothing else, into the instance stream the draws read. One point per instance, hiz_compact.geom
+// hands the kept ones on to transform feedback.
+
+// the instance data as the draw lays it out, as many columns as it has, the rest unset
+layout (location = 0) in vec4 column0;
+layout (location = 1) in vec4 column1;
+layout (location = 2) in vec4 column2;
+layout (location = 3) in vec4 column3;
+// bit 0 visible this frame, bit 1 visible last frame
+layout (location = 4) in uint visibility;
+
+// instances whose visibility & drawMask isn't drawValue are dropped
+uniform uint drawMask;
+uniform uint drawValue;
+
+out Instance {
+    vec4 columns[4];
+    flat uint kept;
+} instance;
+
+void main()
+{
+    instance.columns[0] = column0;
+    instance.columns[1] = column1;
+    instance.columns[2] = column2;
+    instance.columns[3] = column3;
+    instance.kept = (visibility & drawMask) == drawValue ? 1u : 0u;
+}
@@ -0,0 +1,11 @@
+#version 410 core
+// Level 0 of the Hi-Z pyramid: the depth buffer as is, one texel per pixel.
+
+uniform sampler2D depth;
+
+out float farthest;
+
+void main()
+{
+    farthest = texelFetch(depth, ivec2(gl_FragCoord.xy), 0).r;
+}
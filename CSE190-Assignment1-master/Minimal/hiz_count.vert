@@ -0,0 +1,35 @@
+#version 410 core
+// Occlusion culling, before a phase's draws: the indirect draw command of each draw, with as
+// many instances as hiz_compact kept of its slots. One point per draw, captured with transform
+// feedback as a DrawElementsIndirectCommand; a strip reads the first four as a
+// DrawArraysIndirectCommand, its base vertex is 0.
+
+// vertices or indices, first index, base vertex, first slot
+layout (location = 0) in uvec4 draw;
+// slots from the first on
+layout (location = 1) in uint slots;
+
+// bit 0 visible this frame, bit 1 visible last frame, per slot
+uniform usamplerBuffer visibility;
+// instances whose visibility & drawMask isn't drawValue are dropped
+uniform uint drawMask;
+uniform uint drawValue;
+
+flat out uint count;
+flat out uint instanceCount;
+flat out uint first;
+flat out int baseVertex;
+flat out uint reserved;
+
+void main()
+{
+    uint kept = 0u;
+    for (uint i = 0u; i < slots; i++)
+        if ((texelFetch(visibility, int(draw.w + i)).r & drawMask) == drawValue)
+            kept++;
+    count = draw.x;
+    instanceCount = kept;
+    first = draw.y;
+    baseVertex = int(draw.z);
+    reserved = 0u;
+}
@@ -0,0 +1,68 @@
+#version 410 core
+// Occlusion culling, second phase: tests every instance's bounding sphere against the Hi-Z
+// pyramid of what the first phase drew. One point per instance, captured with transform
+// feedback; nothing is rasterized.
+
+layout (location = 0) in mat4 toWorld;
+// from the carry pass, bit 1: visible last frame
+layout (location = 4) in uint carried;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+uniform vec4 bounds;     // model space bounding sphere: center, radius
+uniform vec4 viewport;   // the eye's part of the pyramid in level 0 texels: x, y, width, height
+
+// bit 0: visible now, bit 1 as carried
+flat out uint visibility;
+
+bool visible()
+{
+    vec3 center = vec3(toWorld * vec4(bounds.xyz, 1.0));
+    float scale = max(length(toWorld[0].xyz), max(length(toWorld[1].xyz), length(toWorld[2].xyz)));
+    float radius = bounds.w * scale;
+
+    // screen rectangle and nearest depth of the box around the sphere
+    mat4 viewProjection = projection * view;
+    vec3 lo = vec3(1e30), hi = vec3(-1e30);
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        // reaches behind the eye, no rectangle to test
+        if (clip.w <= 0.0)
+            return true;
+        vec3 ndc = clip.xyz / clip.w;
+        lo = min(lo, ndc);
+        hi = max(hi, ndc);
+    }
+
+    // outside the frustum
+    if (any(greaterThan(lo.xy, vec2(1.0))) || any(lessThan(hi.xy, vec2(-1.0))) || lo.z > 1.0)
+        return false;
+    if (lo.z < -1.0)
+        return true;
+
+    vec2 rectLo = viewport.xy + (clamp(lo.xy, -1.0, 1.0) * 0.5 + 0.5) * viewport.zw;
+    vec2 rectHi = viewport.xy + (clamp(hi.xy, -1.0, 1.0) * 0.5 + 0.5) * viewport.zw;
+
+    // the level on which the rectangle spans at most 2x2 texels
+    vec2 size = rectHi - rectLo;
+    int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, hiZLevels - 1);
+    ivec2 levelSize = textureSize(hiZ, level);
+    ivec2 a = clamp(ivec2(rectLo) >> level, ivec2(0), levelSize - 1);
+    ivec2 b = clamp(ivec2(rectHi) >> level, ivec2(0), levelSize - 1);
+    float farthest = max(max(texelFetch(hiZ, a, level).r, texelFetch(hiZ, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(hiZ, ivec2(a.x, b.y), level).r, texelFetch(hiZ, b, level).r));
+
+    // visible unless everything drawn there is nearer than the sphere's nearest point
+    return lo.z * 0.5 + 0.5 <= farthest;
+}
+
+void main()
+{
+    visibility = (carried & 2u) | (visible() ? 1u : 0u);
+}
@@ -0,0 +1,33 @@
+#version 410 core
+// One Hi-Z level from the one above: the farthest depth of the 2x2 texels each texel covers.
+// Where the level above has an odd width or height, the last column or row of texels also
+// takes in the third one, so every pixel of level 0 is covered by some texel on each level.
+
+// the pyramid, limited to the level above (base and max level) while this one is drawn
+uniform sampler2D source;
+
+out float farthest;
+
+float fetch(ivec2 texel, ivec2 size)
+{
+    return texelFetch(source, min(texel, size - 1), 0).r;
+}
+
+void main()
+{
+    ivec2 size = textureSize(source, 0);
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+    float depth = max(max(fetch(texel, size), fetch(texel + ivec2(1, 0), size)),
+                      max(fetch(texel + ivec2(0, 1), size), fetch(texel + ivec2(1, 1), size)));
+
+    ivec2 levelSize = max(size / 2, ivec2(1));
+    bool lastColumn = (size.x & 1) != 0 && int(gl_FragCoord.x) == levelSize.x - 1;
+    bool lastRow = (size.y & 1) != 0 && int(gl_FragCoord.y) == levelSize.y - 1;
+    if (lastColumn)
+        depth = max(depth, max(fetch(texel + ivec2(2, 0), size), fetch(texel + ivec2(2, 1), size)));
+    if (lastRow)
+        depth = max(depth, max(fetch(texel + ivec2(0, 2), size), fetch(texel + ivec2(1, 2), size)));
+    if (lastColumn && lastRow)
+        depth = max(depth, fetch(texel + ivec2(2, 2), size));
+    farthest = depth;
+}
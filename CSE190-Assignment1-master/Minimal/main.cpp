@@ -46,6 +46,7 @@ limitations under the License.
 #include <glm/gtx/quaternion.hpp>
 
 // Import the most commonly used types into the default namespace
+using glm::ivec4;
 using glm::ivec3;
 using glm::ivec2;
 using glm::uvec2;
@@ -62,6 +63,23 @@ using glm::quat;
 //
 
 #include <GL/glew.h>
+#include "ResourceRegistry.h"
+#include "TextureStreamer.h"
+#include "StreamBuffer.h"
+#include "shader.h"
+#include "GlHandle.h"
+#include "AllocationTracker.h"
+#include "FrameAllocator.h"
+#include "FrameStats.h"
+#include "ThreadTuning.h"
+#include "JobSystem.h"
+#include "UploadThread.h"
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 bool checkFramebufferStatus(GLenum target = GL_FRAMEBUFFER) {
   GLuint status = glCheckFramebufferStatus(target);
@@ -175,11 +193,41 @@ namespace glfw
 // A class to encapsulate using GLFW to handle input and render a scene
 class GlfwApp {
 
+public:
+  // How the loop runs, set before run(). With the render thread the main thread polls events
+  // and runs update(), and a second thread that owns the GL context renders; update() hands
+  // its results over through a snapshot (see TripleBuffer) instead of sharing state
+  struct RenderThreadOptions {
+    bool enabled{true};          // false: events, update and draw all on the main thread
+    int cpu{-1};                 // core to pin the render thread to, -1 leaves it to the OS
+    bool raisePriority{false};   // real-time / higher priority for the render thread
+  };
+  RenderThreadOptions renderThreadOptions;
+
 protected:
   uvec2 windowSize;
   ivec2 windowPosition;
   GLFWwindow* window{nullptr};
   unsigned int frame{0};
+  // scratch memory for the current frame, emptied before each one
+  FrameAllocator frameAllocator;
+
+  // frames allowed to allocate while caches, buffers and glyphs settle in
+  static const unsigned int ALLOCATION_WARMUP_FRAMES = 300;
+  uint64_t reportedAllocations{0};
+  unsigned int lastAllocationReport{0};
+  // steady-state allocations of the simulation thread, folded into the next frame's check
+  std::atomic<uint64_t> simulationAllocations{0};
+
+  // frame to frame times at the end of every frame (F prints them)
+  FrameStats frameStats;
+  std::atomic<bool> frameStatsRequested{false};
+
+  // render thread handshake: the simulation steps once for every frame that starts
+  std::atomic<bool> rendering{false};
+  std::mutex frameMutex;
+  std::condition_variable frameStarted;
+  unsigned int startedFrame{0};
 
 public:
   GlfwApp() {
@@ -211,14 +259,23 @@ public:
 
     initGl();
 
-    while (!glfwWindowShouldClose(window)) {
-      ++frame;
-      glfwPollEvents();
-      update();
-      draw();
-      finishFrame();
+    if (renderThreadOptions.enabled) {
+      runThreaded();
     }
+    else {
+      while (!glfwWindowShouldClose(window)) {
+        alloc::Guard guard;
+        glfwPollEvents();
+        update();
+        renderFrame(guard);
+      }
+    }
+    frameStats.report(std::cout, renderThreadOptions.enabled ? "frame times, render thread" : "frame times, single thread");
+    JobSystem::instance().report(std::cout);
 
+    // lands whatever is still uploading, the main context is current again
+    UploadThread::instance().stop();
+    UploadThread::instance().report(std::cout);
     shutdownGl();
 
     return 0;
@@ -229,6 +286,86 @@ protected:
 
   virtual void draw() = 0;
 
+  // start of every frame on the thread that renders, before draw(): pick up the latest
+  // snapshot from update() and do the GL side housekeeping
+  virtual void beginRender() {
+  }
+
+  void renderFrame(const alloc::Guard& guard) {
+    ++frame;
+    frameAllocator.beginFrame();
+    // completions of uploads the GPU has finished, before anything uses their objects
+    UploadThread::instance().update();
+    beginRender();
+    {
+      std::lock_guard<std::mutex> lock(frameMutex);
+      startedFrame = frame;
+    }
+    frameStarted.notify_one();
+    draw();
+    finishFrame();
+    frameStats.frame();
+    if (frameStatsRequested.exchange(false)) {
+      alloc::Exempt exempt;
+      frameStats.report(std::cout, "frame times");
+      JobSystem::instance().report(std::cout);
+    }
+    checkAllocations(guard.allocations() + simulationAllocations.exchange(0));
+  }
+
+  void runThreaded() {
+    // the render thread owns the context until it stops
+    glfwMakeContextCurrent(nullptr);
+    rendering = true;
+    std::exception_ptr renderError;
+    std::thread renderer([this, &renderError] {
+      threading::setName("render");
+      if (renderThreadOptions.cpu >= 0 && !threading::pinToCpu(renderThreadOptions.cpu)) {
+        printf("render thread: could not pin to CPU %d\n", renderThreadOptions.cpu);
+      }
+      if (renderThreadOptions.raisePriority && !threading::raisePriority()) {
+        printf("render thread: could not raise its priority\n");
+      }
+      glfwMakeContextCurrent(window);
+      try {
+        while (rendering) {
+          alloc::Guard guard;
+          renderFrame(guard);
+        }
+      }
+      catch (...) {
+        renderError = std::current_exception();
+      }
+      glfwMakeContextCurrent(nullptr);
+      rendering = false;
+    });
+
+    // events are polled every couple of milliseconds, update() runs once per started frame
+    unsigned int simulatedFrame = 0;
+    while (rendering && !glfwWindowShouldClose(window)) {
+      glfwPollEvents();
+      {
+        std::unique_lock<std::mutex> lock(frameMutex);
+        if (!frameStarted.wait_for(lock, std::chrono::milliseconds(2),
+                                   [&] { return startedFrame != simulatedFrame; })) {
+          continue;
+        }
+        simulatedFrame = startedFrame;
+      }
+      alloc::Guard guard;
+      update();
+      if (simulatedFrame > ALLOCATION_WARMUP_FRAMES) {
+        simulationAllocations += guard.allocations();
+      }
+    }
+    rendering = false;
+    renderer.join();
+    glfwMakeContextCurrent(window);
+    if (renderError) {
+      std::rethrow_exception(renderError);
+    }
+  }
+
   void preCreate() {
     glfwWindowHint(GLFW_DEPTH_BITS, 16);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -252,6 +389,9 @@ protected:
     }
     glGetError();
 
+    // buffer and texture uploads from here on go through a context sharing this one
+    UploadThread::instance().start(window);
+
     if (GLEW_KHR_debug) {
       GLint v;
       glGetIntegerv(GL_CONTEXT_FLAGS, &v);
@@ -286,12 +426,34 @@ protected:
     case GLFW_KEY_ESCAPE:
       glfwSetWindowShouldClose(window, 1);
       return;
+
+    case GLFW_KEY_F:
+      frameStatsRequested = true;
+      return;
     }
   }
 
+  // simulation, on the main thread; must not touch GL
   virtual void update() {
   }
 
+  // a frame after warm-up must not touch the general heap; report it (throttled), or stop
+  // right there with ALLOCATION_GUARD_ASSERT defined
+  void checkAllocations(uint64_t allocations) {
+    if (frame <= ALLOCATION_WARMUP_FRAMES || allocations == 0) {
+      return;
+    }
+#ifdef ALLOCATION_GUARD_ASSERT
+    assert(allocations == 0 && "heap allocation in a steady-state frame");
+#endif
+    reportedAllocations += allocations;
+    if (frame - lastAllocationReport >= 600 || lastAllocationReport == 0) {
+      printf("frame %u: %llu heap allocations (%llu since warm-up)\n", frame,
+             (unsigned long long)allocations, (unsigned long long)reportedAllocations);
+      lastAllocationReport = frame;
+    }
+  }
+
   virtual void onMouseButton(int button, int action, int mods) {
   }
 
@@ -431,11 +593,11 @@ class RiftApp : public GlfwApp, public RiftManagerApp {
 public:
 
 private:
-  GLuint _fbo{0};
-  GLuint _depthBuffer{0};
+  FramebufferHandle _fbo;
+  TextureHandle _depthTexture;   // a texture so passes like occlusion culling can read it
   ovrTextureSwapChain _eyeTexture;
 
-  GLuint _mirrorFbo{0};
+  FramebufferHandle _mirrorFbo;
   ovrMirrorTexture _mirrorTexture;
 
   ovrEyeRenderDesc _eyeRenderDescs[2];
@@ -447,6 +609,9 @@ private:
 
   uvec2 _renderTargetSize;
   uvec2 _mirrorSize;
+  ovrEyeType _currentEye{ovrEye_Left};
+
+  std::atomic<bool> resourceReportRequested{false};
 
 public:
 
@@ -490,6 +655,10 @@ protected:
     // Disable the v-sync for buffer swap
     glfwSwapInterval(0);
 
+    // The eye and mirror textures are sRGB, so let GL encode on write. Together with sRGB
+    // colour textures (decoded on read) shading and blending happen in linear light
+    glEnable(GL_FRAMEBUFFER_SRGB);
+
     ovrTextureSwapChainDesc desc = {};
     desc.Type = ovrTexture_2D;
     desc.ArraySize = 1;
@@ -522,15 +691,29 @@ protected:
     glBindTexture(GL_TEXTURE_2D, 0);
 
     // Set up the framebuffer object
-    glGenFramebuffers(1, &_fbo);
-    glGenRenderbuffers(1, &_depthBuffer);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, _renderTargetSize.x, _renderTargetSize.y);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
+    _fbo = FramebufferHandle::create();
+    _depthTexture = TextureHandle::create();
+    glBindTexture(GL_TEXTURE_2D, _depthTexture.get());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, _renderTargetSize.x, _renderTargetSize.y, 0,
+                 GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo.get());
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _depthTexture.get(), 0);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
+    ResourceRegistry& registry = ResourceRegistry::instance();
+    registry.track(ResourceKind::Framebuffer, _fbo.get(), 0, "eye framebuffer");
+    registry.track(ResourceKind::Texture, _depthTexture.get(),
+                   ResourceRegistry::textureBytes(GL_DEPTH_COMPONENT16, _renderTargetSize.x, _renderTargetSize.y, false),
+                   "eye depth buffer");
+    // the swap chain is owned by the runtime, but it is still our VRAM
+    registry.track(ResourceKind::Texture, 0,
+                   length * ResourceRegistry::textureBytes(GL_RGBA8, _renderTargetSize.x, _renderTargetSize.y, false),
+                   "ovr eye swap chain (" + std::to_string(length) + " images)");
+
     ovrMirrorTextureDesc mirrorDesc;
     memset(&mirrorDesc, 0, sizeof(mirrorDesc));
     mirrorDesc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
@@ -539,7 +722,20 @@ protected:
     if (!OVR_SUCCESS(ovr_CreateMirrorTextureGL(_session, &mirrorDesc, &_mirrorTexture))) {
       FAIL("Could not create mirror texture");
     }
-    glGenFramebuffers(1, &_mirrorFbo);
+    _mirrorFbo = FramebufferHandle::create();
+    registry.track(ResourceKind::Framebuffer, _mirrorFbo.get(), 0, "mirror framebuffer");
+
+    // mip selection works from the eye viewport height
+    TextureStreamer::instance().setViewportHeight(_renderTargetSize.y);
+  }
+
+  void shutdownGl() override {
+    _fbo.reset();
+    _depthTexture.reset();
+    _mirrorFbo.reset();
+    // the context is still alive, delete everything released so far
+    DeletionQueue::instance().flush();
+    GlfwApp::shutdownGl();
   }
 
   void onKey(int key, int scancode, int action, int mods) override {
@@ -548,29 +744,57 @@ protected:
       case GLFW_KEY_R:
         ovr_RecenterTrackingOrigin(_session);
         return;
+
+      case GLFW_KEY_M:
+        // the registry belongs to the render thread
+        resourceReportRequested = true;
+        return;
       }
 
     GlfwApp::onKey(key, scancode, action, mods);
   }
 
   void draw() final override {
+    if (resourceReportRequested.exchange(false)) {
+      alloc::Exempt exempt;
+      ResourceRegistry::instance().report(std::cout);
+    }
+
+    StreamBuffer& stream = StreamBuffer::instance();
+    stream.beginFrame();
+
     ovrPosef eyePoses[2];
     ovr_GetEyePoses(_session, frame, true, _viewScaleDesc.HmdToEyePose, eyePoses, &_sceneLayer.SensorSampleTime);
+    // both eyes look the same way, work shared by them is done from halfway between
+    ovrPosef centerPose = eyePoses[0];
+    centerPose.Position.x = (eyePoses[0].Position.x + eyePoses[1].Position.x) * 0.5f;
+    centerPose.Position.y = (eyePoses[0].Position.y + eyePoses[1].Position.y) * 0.5f;
+    centerPose.Position.z = (eyePoses[0].Position.z + eyePoses[1].Position.z) * 0.5f;
+    mat4 headPoses[2] = { ovr::toGlm(eyePoses[0]), ovr::toGlm(eyePoses[1]) };
+    prepareEyes(ovr::toGlm(centerPose), headPoses);
 
     int curIndex;
     ovr_GetTextureSwapChainCurrentIndex(_session, _eyeTexture, &curIndex);
     GLuint curTexId;
     ovr_GetTextureSwapChainBufferGL(_session, _eyeTexture, curIndex, &curTexId);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo.get());
     glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, curTexId, 0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     ovr::for_each_eye([&](ovrEyeType eye)
     {
       const auto& vp = _sceneLayer.Viewport[eye];
       glViewport(vp.Pos.x, vp.Pos.y, vp.Size.w, vp.Size.h);
+      _currentEye = eye;
       _sceneLayer.RenderPose[eye] = eyePoses[eye];
-      renderScene(_eyeProjections[eye], ovr::toGlm(eyePoses[eye]));
+      const mat4& headPose = headPoses[eye];
+      // one Camera block per eye instead of projection / modelview uniforms per draw
+      mat4 camera[2] = { _eyeProjections[eye], glm::inverse(headPose) };
+      stream.bindUniform(CAMERA_BLOCK_BINDING, camera, sizeof(camera));
+      renderScene(_eyeProjections[eye], headPose);
     });
+    stream.endFrame();
+    // objects released this frame are deleted once the GPU gets past it
+    DeletionQueue::instance().endFrame();
     glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
     ovr_CommitTextureSwapChain(_session, _eyeTexture);
@@ -579,13 +803,30 @@ protected:
 
     GLuint mirrorTextureId;
     ovr_GetMirrorTextureBufferGL(_session, _mirrorTexture, &mirrorTextureId);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, _mirrorFbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _mirrorFbo.get());
     glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mirrorTextureId, 0);
     glBlitFramebuffer(0, 0, _mirrorSize.x, _mirrorSize.y, 0, _mirrorSize.y, _mirrorSize.x, 0, GL_COLOR_BUFFER_BIT,
                       GL_NEAREST);
     glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
   }
 
+  // once a frame before the eyes are rendered, with the pose between the two eyes and the
+  // pose of each eye renderScene will get
+  virtual void prepareEyes(const glm::mat4& centerPose, const glm::mat4 headPoses[2]) {
+  }
+
+  // the render target both eyes go to, side by side, for passes that read it back
+  GLuint eyeFramebuffer() const { return _fbo.get(); }
+  GLuint eyeDepthTexture() const { return _depthTexture.get(); }
+  uvec2 renderTargetSize() const { return _renderTargetSize; }
+  const mat4& eyeProjection(ovrEyeType eye) const { return _eyeProjections[eye]; }
+  // while renderScene runs: the eye and its part of the render target (x, y, width, height)
+  ovrEyeType currentEye() const { return _currentEye; }
+  ivec4 eyeViewport(ovrEyeType eye) const {
+    const ovrRecti& vp = _sceneLayer.Viewport[eye];
+    return ivec4(vp.Pos.x, vp.Pos.y, vp.Size.w, vp.Size.h);
+  }
+
   virtual void renderScene(const glm::mat4& projection, const glm::mat4& headPose) = 0;
 };
 
@@ -602,12 +843,32 @@ protected:
 #include "Model.h"
 #include "Mesh.h"
 #include <ctime>
-#include <ft2build.h>
-#include FT_FREETYPE_H  
+#include "TextRenderer.h"
+#include "TextLayoutCache.h"
+#include "SceneManager.h"
+#include "TripleBuffer.h"
+#include "InputSampler.h"
+#include "DepthSort.h"
+#include "PassQueries.h"
+#include "HiZCuller.h"
+#include "SoftwareOcclusion.h"
+#include "SphereImpostors.h"
+#include "DrawStream.h"
+
+/* SphereDraws - what one eye draws of the spheres this frame (frame memory): transforms in draw
+   order, the sphere at each slot, the highlighted slot (-1 for none) and where each level of
+   detail's slots end, the levels following each other from the full one */
+struct SphereDraws {
+	glm::mat4* transforms = nullptr;
+	uint32_t* order = nullptr;
+	unsigned int count = 0;
+	int highlighted = -1;
+	unsigned int lodEnd[Mesh::MAX_LODS] = {};
+};
 
 /* ColorSphereScene - Generate A Grid of 5 * 5 * 5 spheres (Render sphere in  5 * 5 * 5 different positions) */
 
-class ColorSphereScene {
+class ColorSphereScene : public Scene {
 
 	// Program
 public:
@@ -617,61 +878,170 @@ public:
     GLuint instanceCount;
 	std::vector<vec3> spheres_positions;
 
-	// Shader ID
-	GLuint shaderID;
-	GLuint unhighlightID;
-	GLuint highlightID;
+	// Shader Programs
+	ProgramHandle unhighlightProgram;
+	ProgramHandle highlightProgram;
 
 	// Sphere
 	std::unique_ptr<Model> sphere;
+	std::string modelPath;
 
 	// Grid Size : 5
-	const unsigned int GRID_SIZE{ 5 };
+	static const unsigned int GRID_SIZE = 5;
+
+	// Level of detail of every sphere, kept from frame to frame for the hysteresis
+	std::vector<uint8_t> lods;
+
+	// The sphere the mesh approximates, model space, for drawing it as an impostor
+	vec3 sphereCenter{ 0.0f };
+	float sphereRadius = 0.0f;
+
+private:
+	// Loaded by preload, turned into GL objects by create
+	ModelImport sphereImport;
+	ShaderSources highlightSources, unhighlightSources;
+	// The programs compile on the upload thread, they are handed over once its ticket is done
+	UploadThread::Ticket programsTicket = 0;
+	GLuint compiledHighlight = 0, compiledUnhighlight = 0;
 
 public:
-	ColorSphereScene() {
+	ColorSphereScene(const std::string& modelPath = "webtrcc.obj") : modelPath(modelPath) {}
+
+	/* The programs' upload reads the sources and writes into the scene */
+	~ColorSphereScene() {
+		if (programsTicket)
+			UploadThread::instance().wait(programsTicket);
+	}
+
+	/* Position of sphere index in the grid, x fastest; the game uses it without a scene at hand */
+	static vec3 gridPosition(unsigned int index) {
+		unsigned int x = index % GRID_SIZE, y = index / GRID_SIZE % GRID_SIZE, z = index / (GRID_SIZE * GRID_SIZE);
+		return vec3(0.14f * x, 0.14f * y, 0.14f * z);
+	}
+
+	/* Loading thread: positions, the sphere model and the shader sources, no GL */
+	void preload() override {
 		// Create a cube of spheres
-		{
-			for (unsigned int z = 0; z < GRID_SIZE; ++z) {
-				for (unsigned int y = 0; y < GRID_SIZE; ++y) {
-					for (unsigned int x = 0; x < GRID_SIZE; ++x) {
-						float xpos = 0.14f * x;
-						float ypos = 0.14f * y;
-						float zpos = 0.14f * z;
-						vec3 relativePosition = vec3(xpos, ypos, zpos);
-						// Store sphere positions
-						spheres_positions.push_back(relativePosition);
-						instance_positions.push_back(glm::translate(glm::mat4(1.0f), relativePosition));
-					}
-				}
-			}
+		for (unsigned int i = 0; i < GRID_SIZE * GRID_SIZE * GRID_SIZE; ++i) {
+			vec3 relativePosition = gridPosition(i);
+			// Store sphere positions
+			spheres_positions.push_back(relativePosition);
+			instance_positions.push_back(glm::translate(glm::mat4(1.0f), relativePosition));
 		}
 		instanceCount = instance_positions.size();
+		lods.assign(instanceCount, 0);
+
+		// Shader Sources (Unhighlight / Highlight)
+		highlightSources = ReadShaders("shader.vert", "shader_highlight.frag");
+		unhighlightSources = ReadShaders("shader.vert", "shader_unhighlight.frag");
+
+		// Sphere, and the center and radius of its vertices
+		sphereImport = Model::Import(modelPath);
+		const ModelImport::Buffers& buffers = sphereImport.buffers;
+		if (buffers.vertexCount > 0) {
+			vec3 lo = buffers.vertices[0].Position, hi = lo;
+			for (size_t i = 1; i < buffers.vertexCount; i++) {
+				lo = glm::min(lo, buffers.vertices[i].Position);
+				hi = glm::max(hi, buffers.vertices[i].Position);
+			}
+			sphereCenter = (lo + hi) * 0.5f;
+			for (size_t i = 0; i < buffers.vertexCount; i++)
+				sphereRadius = std::max(sphereRadius, glm::length(buffers.vertices[i].Position - sphereCenter));
+		}
+	}
 
-		// Shader Program (Unhighlight / Highlight)
-		highlightID = LoadShaders("shader.vert", "shader_highlight.frag");
-		unhighlightID = LoadShaders("shader.vert", "shader_unhighlight.frag");
+	/* GL thread: start compiling the programs and uploading the sphere, both on the upload thread
+	   (programs are shared between the contexts like buffers), so the switch frame only queues work */
+	void create() override {
+		programsTicket = UploadThread::instance().submit([this] {
+			compiledHighlight = CompileShaders(highlightSources);
+			compiledUnhighlight = CompileShaders(unhighlightSources);
+		}, [this] {
+			highlightProgram = ProgramHandle(compiledHighlight);
+			unhighlightProgram = ProgramHandle(compiledUnhighlight);
+			highlightSources = ShaderSources();
+			unhighlightSources = ShaderSources();
+		});
+		sphere = std::make_unique<Model>(std::move(sphereImport));
+	}
 
-		// Set Default Shader ID to Unlighlight Shader
-		shaderID = unhighlightID;
+	/* The programs are linked and the sphere's geometry is on the GPU */
+	bool ready() override {
+		return UploadThread::instance().done(programsTicket) && sphere->ready();
+	}
 
-		// Sphere
-		sphere = std::make_unique<Model>("webtrcc.obj");
+	/* World transform of every sphere for this frame, in frame memory, computed as jobs */
+	glm::mat4* worldTransforms(FrameAllocator& frameAllocator, const glm::mat4& change) {
+		glm::mat4* transforms = frameAllocator.allocate<glm::mat4>(instanceCount);
+		glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(0.035f));
+		JobSystem::instance().parallelFor(instanceCount, 32, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				transforms[i] = change * instance_positions[i] * scale;
+		});
+		return transforms;
 	}
 
-	/* Render sphere at index position */
-	void render(const glm::mat4& projection, const glm::mat4& view, unsigned int index, glm::mat4& change) {
-		glm::mat4 toWorld = change*instance_positions[index] * glm::scale(glm::mat4(1.0f), glm::vec3(0.035f));
-		sphere->Draw(shaderID, projection, view, toWorld);
+	/* Level of detail of every sphere with these transforms for this frame, the same for both eyes
+	   (views and projections) so they never see different meshes; all full detail without enabled */
+	void selectLods(const glm::mat4* transforms, const glm::mat4 projections[2], const glm::mat4 views[2], float viewportHeight, bool enabled) {
+		JobSystem::instance().parallelFor(instanceCount, 32, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				lods[i] = enabled ? (uint8_t)sphere->selectLod(sphere->pixelsPerUnit(transforms[i], projections, views, 2, viewportHeight), lods[i]) : 0;
+		});
 	}
 
-	/* Switch between Highlight and Unhighlight */
-	void highlight() {
-		shaderID = highlightID;
+	/* Record the spheres of draws in the order given, one level of detail after the other: in each,
+	   the spheres before and after the highlighted one as (at most) two instanced draws, the
+	   highlighted one with its own shader in between, so a front-to-back order is kept. Each
+	   draw's first slot is where its instances' bits are in an occlusion culling replay */
+	void record(DrawStream& stream, const glm::mat4& projection, const glm::mat4& view, const SphereDraws& draws) {
+		// the first scene is shown straight away, before its uploads have landed
+		if (!ready())
+			return;
+		int begin = 0;
+		for (int lod = 0; lod < Mesh::MAX_LODS; lod++) {
+			int end = (int)draws.lodEnd[lod];
+			const glm::mat4* transforms = draws.transforms;
+			if (draws.highlighted < begin || draws.highlighted >= end) {
+				sphere->RecordInstanced(stream, unhighlightProgram.get(), projection, view, transforms + begin, end - begin, begin, lod);
+			}
+			else {
+				int highlighted = draws.highlighted;
+				sphere->RecordInstanced(stream, unhighlightProgram.get(), projection, view, transforms + begin, highlighted - begin, begin, lod);
+				sphere->RecordInstanced(stream, highlightProgram.get(), projection, view, transforms + highlighted, 1, highlighted, lod);
+				sphere->RecordInstanced(stream, unhighlightProgram.get(), projection, view, transforms + highlighted + 1, end - highlighted - 1,
+				                        highlighted + 1, lod);
+			}
+			begin = end;
+		}
 	}
 
-	void unhighlight() {
-		shaderID = unhighlightID;
+	/* Record the spheres of draws like record, as exact spheres with impostors; one draw for the
+	   spheres before the highlighted one and one for those after, levels of detail don't matter */
+	void recordImpostors(SphereImpostors& impostors, DrawStream& stream, FrameAllocator& frameAllocator, const SphereDraws& draws) {
+		int count = (int)draws.count;
+		glm::vec4* spheres = frameAllocator.allocate<glm::vec4>(count);
+		for (int i = 0; i < count; i++) {
+			const glm::mat4& toWorld = draws.transforms[i];
+			float scale = std::max(glm::length(vec3(toWorld[0])), std::max(glm::length(vec3(toWorld[1])), glm::length(vec3(toWorld[2]))));
+			spheres[i] = glm::vec4(vec3(toWorld * glm::vec4(sphereCenter, 1.0f)), sphereRadius * scale);
+		}
+		int highlighted = draws.highlighted;
+		if (highlighted < 0 || highlighted >= count) {
+			impostors.record(stream, spheres, count, false, glm::mat3(1.0f));
+		}
+		else {
+			// world space normals back into the sphere's model frame, as the mesh shows its normals
+			glm::mat3 worldToModel = glm::inverse(glm::mat3(draws.transforms[highlighted]));
+			impostors.record(stream, spheres, highlighted, false, glm::mat3(1.0f));
+			impostors.record(stream, spheres + highlighted, 1, true, worldToModel, highlighted);
+			impostors.record(stream, spheres + highlighted + 1, count - highlighted - 1, false, glm::mat3(1.0f), highlighted + 1);
+		}
+	}
+
+	// model space sphere around one sphere instance
+	void bounds(glm::vec3& center, float& radius) const {
+		sphere->bounds(center, radius);
 	}
 };
 
@@ -679,8 +1049,8 @@ public:
 
 class Cursor {
 
-	// Shader ID
-	GLuint shaderID;
+	// Shader Program
+	ProgramHandle program;
 
 	// Cursor
 	std::unique_ptr<Model> cursor;
@@ -688,31 +1058,36 @@ class Cursor {
 	// User's Dominant Hand's Controller Position 
 	vec3 position;
 
+	// Level of detail, picked once a frame for both eyes
+	int lod = 0;
+
 
 public:
 	Cursor(){
-		shaderID = LoadShaders("shader.vert", "shader_highlight.frag");
+		program = ProgramHandle(LoadShaders("shader.vert", "shader_highlight.frag"));
 		cursor = std::make_unique<Model>("webtrcc.obj");
 	}
 
-	/* Render sphere at User's Dominant Hand's Controller Position */
-	void render(const glm::mat4& projection, const glm::mat4& view, vec3 pos) {
-		position = pos;
-		glm::mat4 toWorld = glm::translate(glm::mat4(1.0f), position) * glm::scale(glm::mat4(1.0f), glm::vec3(0.02f));
-		cursor->Draw(shaderID, projection, view, toWorld);
+	/* Level of detail for the cursor at pos this frame, seen with views and projections of both eyes */
+	void selectLod(vec3 pos, const glm::mat4 projections[2], const glm::mat4 views[2], float viewportHeight, bool enabled) {
+		lod = enabled ? cursor->selectLod(cursor->pixelsPerUnit(transform(pos), projections, views, 2, viewportHeight), lod) : 0;
 	}
 
-};
+	/* Record the sphere at User's Dominant Hand's Controller Position */
+	void record(DrawStream& stream, const glm::mat4& projection, const glm::mat4& view, vec3 pos) {
+		position = pos;
+		glm::mat4 toWorld = transform(position);
+		cursor->RecordInstanced(stream, program.get(), projection, view, &toWorld, 1, 0, lod);
+	}
 
+private:
+	static glm::mat4 transform(vec3 pos) {
+		return glm::translate(glm::mat4(1.0f), pos) * glm::scale(glm::mat4(1.0f), glm::vec3(0.02f));
+	}
 
-//
-struct Character {
-	GLuint     TextureID;  // ID handle of the glyph texture
-	glm::ivec2 Size;       // Size of glyph
-	glm::ivec2 Bearing;    // Offset from baseline to left/top of glyph
-	GLuint     Advance;    // Offset to advance to next glyph
 };
 
+
 /* Example APP */
 
 class ExampleApp : public RiftApp {
@@ -723,14 +1098,18 @@ class ExampleApp : public RiftApp {
 	// Hand Tracking
 	double displayMidpointSeconds;
 	ovrTrackingState trackState;
-	ovrInputState  inputState;
 	unsigned int handStatus[2];
 	ovrPosef handPoses[2];
 	ovrVector3f handPosition[2];
 	ovrQuatf handRotation[2];
 
-	// Sphere Scene
-	std::shared_ptr<ColorSphereScene> sphereScene;
+	// Controller buttons and touches, sampled off the frame loop
+	InputSampler input{ _session };
+
+	// Sphere Scene, swapped by the scene manager between frames
+	SceneManager scenes;
+	ColorSphereScene* sphereScene = nullptr;
+	std::atomic<bool> sceneReloadRequested{ false };
 	// Cursor
 	std::shared_ptr<Cursor> cursor;
 
@@ -742,7 +1121,7 @@ class ExampleApp : public RiftApp {
 
 	// Timer
 	std::clock_t start;
-	double duration;
+	double duration = 0;
 
 	// Number of Scores
 	int score = 0;
@@ -750,15 +1129,89 @@ class ExampleApp : public RiftApp {
 	// Number of Spheres
 	unsigned int NUM_SPHERES = 125;
 
-	//
-	std::map<GLchar, Character> Characters;
-
-	//
-	GLuint VAO, VBO;
-
+	// What update() decided, everything renderScene needs (written by update, read while rendering)
+	struct GameSnapshot {
+		vec3 cursorPosition{ 0.0f };
+		glm::mat4 spheresToWorld{ 1.0f };   // the grabbed set of spheres
+		bool playing{ false };
+		int highlighted{ -1 };
+		int score{ 0 };
+		int secondsLeft{ 60 };
+	};
+	TripleBuffer<GameSnapshot> snapshots;
+
+	// Sphere world transforms of the current frame (frame memory), shared by both eyes
+	glm::mat4* sphereTransforms = nullptr;
+
+	// Draw order of the spheres, nearest to the eyes first so early-Z rejects what's behind them
+	// (frame memory); O switches back to grid order to compare the two
+	glm::mat4* drawTransforms = nullptr;
+	uint32_t* drawOrder = nullptr;      // sphere drawn at each slot
+	int drawHighlighted = -1;
+	bool depthSorted = true;
+	std::atomic<bool> depthSortToggleRequested{ false };
+	PassQueries spherePass{ "sphere pass" };
+
+	// Occlusion culling of the spheres against a depth pyramid, per eye; C switches it off and on
+	HiZCuller culler;
+	bool occlusionCulling = true;
+	std::atomic<bool> cullingToggleRequested{ false };
+	PassQueries hiZPass{ "hi-z pyramid and test" };
+
+	// Levels of detail of the spheres and the cursor, by their size on screen; L switches them off
+	// and on. The draw order is grouped by level, front to back within each
+	unsigned int drawLodEnd[Mesh::MAX_LODS] = {};
+	bool levelsOfDetail = true;
+	std::atomic<bool> lodToggleRequested{ false };
+	uint64_t lodFrames = 0, lodTriangles = 0, lodInstances[Mesh::MAX_LODS] = {};
+
+	// The frame's draws, recorded once in prepareEyes and replayed by each eye
+	DrawStream drawStream;
+	DrawStream::Range cursorCommands;
+	DrawStream::Range sphereCommands[2];    // the same range for both eyes unless CPU culling split them
+
+	// Spheres as ray cast impostors instead of meshes; I switches between the two
+	SphereImpostors impostors;
+	bool impostorSpheres = false;
+	std::atomic<bool> impostorToggleRequested{ false };
+
+	// Occlusion culling on the CPU, before anything is submitted: the nearest spheres are drawn
+	// as occluders into a small depth buffer per eye, the boxes around all of them tested
+	// against it; V switches it off and on
+	SphereDraws eyeDraws[2];            // per eye, what's left of the draw order
+	SoftwareOcclusion softwareOcclusion[2];
+	bool softwareCulling = true;
+	std::atomic<bool> softwareCullingToggleRequested{ false };
+	uint64_t softwareFrames = 0, softwareTested = 0, softwareCulled = 0;
+	double softwareMilliseconds = 0.0;
+	const unsigned int OCCLUDER_COUNT = 16;
+	const unsigned int SOFTWARE_OCCLUSION_DIVISOR = 4;  // eye pixels per depth buffer pixel, each way
+	// cube inside each occluder sphere, kept off the sphere mesh's flat faces
+	const float OCCLUDER_SIZE = 0.9f / std::sqrt(3.0f);
+
+	// Score / Timer Text
+	std::unique_ptr<TextRenderer> text;
+	std::unique_ptr<TextLayoutCache> textCache;
+	int statusLabel, scoreLabel, timerLabel;
+	const char* FONT_PATH = "C:/Windows/Fonts/arial.ttf";
+	const float TEXT_SIZE = 0.0015f;
+
+	// Variants of the sphere pass in its GPU reports, compared to the plain grid order
+	const char* const SPHERE_PASS_VARIANTS[PassQueries::VARIANTS] = {
+		"front to back", "grid order", "front to back + Hi-Z", "grid order + Hi-Z",
+		"front to back + CPU", "grid order + CPU", "front to back + CPU + Hi-Z", "grid order + CPU + Hi-Z" };
+	const int SPHERE_PASS_BASELINE = 1;
+	const char* const HIZ_PASS_VARIANTS[PassQueries::VARIANTS] = { "both eyes" };
+
+	int spherePassVariant() const {
+		return (depthSorted ? 0 : 1) + (occlusionCulling && culler.ready() ? 2 : 0) + (softwareCulling ? 4 : 0);
+	}
 
 
 public:
+	// Controller samples per second on the input thread, 0 samples once per frame in update()
+	double inputRate = 500.0;
+
 	ExampleApp() {
 		// Game has not started 
 		GameState = false;
@@ -768,27 +1221,387 @@ protected:
 	void initGl() override {
 		RiftApp::initGl();
 
-		// Background Color
-		glClearColor(0.86f, 0.86f, 0.94f, 0.0f);
+		// Background Color, (0.86, 0.86, 0.94) in sRGB: the eye buffers are sRGB encoded, colours are given linear
+		glClearColor(0.7106f, 0.7106f, 0.8689f, 0.0f);
 
 		glEnable(GL_DEPTH_TEST);
 
 		ovr_RecenterTrackingOrigin(_session);
 
+		// Controller sampling
+		input.start(inputRate);
+
 		// Set up Spheres and Cursor
-		sphereScene = std::shared_ptr<ColorSphereScene>(new ColorSphereScene());
+		scenes.show(std::make_unique<ColorSphereScene>());
+		sphereScene = scenes.current<ColorSphereScene>();
 		cursor = std::shared_ptr<Cursor>(new Cursor());
 
-		
+		// Text
+		text = std::make_unique<TextRenderer>(FONT_PATH);
+		textCache = std::make_unique<TextLayoutCache>();
+		statusLabel = textCache->createLabel(text.get(), TEXT_SIZE, 32);
+		scoreLabel = textCache->createLabel(text.get(), TEXT_SIZE, 16);
+		timerLabel = textCache->createLabel(text.get(), TEXT_SIZE, 16);
+
+		// Sphere impostors, the meshes stay if they can't be set up
+		impostors.init();
+
+		// Occlusion culling, the spheres are simply all drawn if it can't be set up
+		occlusionCulling = culler.init(renderTargetSize());
+		for (int eye = 0; eye < 2; eye++) {
+			ivec4 viewport = eyeViewport((ovrEyeType)eye);
+			softwareOcclusion[eye].resize(viewport.z / SOFTWARE_OCCLUSION_DIVISOR, viewport.w / SOFTWARE_OCCLUSION_DIVISOR);
+		}
+	}
+
+	void beginRender() override {
+		// Latest game state from update(), the previous one again if there is nothing newer
+		snapshots.acquire();
+		const GameSnapshot& game = snapshots.read();
+
+		// Switch to a preloaded scene at the frame boundary, the old one is freed in the background
+		if (sceneReloadRequested.exchange(false)) {
+			alloc::Exempt exempt;
+			scenes.load(std::make_unique<ColorSphereScene>());
+		}
+		if (scenes.update())
+			sphereScene = scenes.current<ColorSphereScene>();
+
+		// Stream in the texture levels last frame's draws asked for, evict over budget
+		TextureStreamer::instance().update(frame);
+
+		// Sphere transforms are the same for both eyes
+		sphereTransforms = sphereScene->worldTransforms(frameAllocator, game.spheresToWorld);
+
+		// GPU time and shaded fragments of the sphere pass, sorted or not, culled or not
+		spherePass.collect();
+		hiZPass.collect();
+		if (depthSortToggleRequested.exchange(false)) {
+			alloc::Exempt exempt;
+			spherePass.report(std::cout, SPHERE_PASS_VARIANTS, SPHERE_PASS_BASELINE);
+			depthSorted = !depthSorted;
+			printf("Spheres drawn %s\n", depthSorted ? "front to back" : "in grid order");
+		}
+		if (cullingToggleRequested.exchange(false) && culler.ready()) {
+			alloc::Exempt exempt;
+			spherePass.report(std::cout, SPHERE_PASS_VARIANTS, SPHERE_PASS_BASELINE);
+			hiZPass.report(std::cout, HIZ_PASS_VARIANTS);
+			occlusionCulling = !occlusionCulling;
+			printf("Occlusion culling %s\n", occlusionCulling ? "on" : "off");
+		}
+		if (softwareCullingToggleRequested.exchange(false)) {
+			alloc::Exempt exempt;
+			spherePass.report(std::cout, SPHERE_PASS_VARIANTS, SPHERE_PASS_BASELINE);
+			reportSoftwareOcclusion();
+			softwareCulling = !softwareCulling;
+			printf("CPU occlusion culling %s\n", softwareCulling ? "on" : "off");
+		}
+		if (lodToggleRequested.exchange(false)) {
+			alloc::Exempt exempt;
+			reportLods();
+			levelsOfDetail = !levelsOfDetail;
+			printf("Levels of detail %s\n", levelsOfDetail ? "on" : "off");
+		}
+		if (impostorToggleRequested.exchange(false) && impostors.ready()) {
+			alloc::Exempt exempt;
+			spherePass.report(std::cout, SPHERE_PASS_VARIANTS, SPHERE_PASS_BASELINE);
+			spherePass.reset();
+			impostorSpheres = !impostorSpheres;
+			printf("Spheres drawn as %s, sphere pass measured anew\n", impostorSpheres ? "impostors" : "meshes");
+		}
+	}
+
+	/* Sphere draw order for both eyes, from between them, then what each eye can't see taken out */
+	void prepareEyes(const glm::mat4& centerPose, const glm::mat4 headPoses[2]) override {
+		const GameSnapshot& game = snapshots.read();
+		unsigned int count = sphereScene->instanceCount;
+		drawTransforms = sphereTransforms;
+		drawHighlighted = game.highlighted;
+		drawOrder = frameAllocator.allocate<uint32_t>(count);
+		if (depthSorted) {
+			depthsort::frontToBack(sphereTransforms, count, vec3(centerPose[3]), -vec3(centerPose[2]), frameAllocator, drawOrder);
+			drawTransforms = frameAllocator.allocate<glm::mat4>(count);
+			for (unsigned int i = 0; i < count; i++) {
+				drawTransforms[i] = sphereTransforms[drawOrder[i]];
+				if ((int)drawOrder[i] == game.highlighted)
+					drawHighlighted = (int)i;
+			}
+		}
+		else {
+			for (unsigned int i = 0; i < count; i++)
+				drawOrder[i] = i;
+		}
+		groupByLod(headPoses, game);
+
+		for (int eye = 0; eye < 2; eye++) {
+			SphereDraws& draws = eyeDraws[eye];
+			draws = SphereDraws{ drawTransforms, drawOrder, count, drawHighlighted };
+			std::copy(drawLodEnd, drawLodEnd + Mesh::MAX_LODS, draws.lodEnd);
+		}
+		if (softwareCulling && count > 0)
+			cullOnCpu(headPoses);
+		recordDraws(centerPose);
+	}
+
+	/* Everything both eyes draw, recorded once: texture requests are made for the view from between
+	   the eyes, instance data goes through the stream buffer a single time. Each eye's sphere
+	   list only gets its own commands when CPU occlusion culling left the eyes different ones */
+	void recordDraws(const glm::mat4& centerPose) {
+		const GameSnapshot& game = snapshots.read();
+		const mat4& projection = eyeProjection(ovrEye_Left);
+		mat4 view = glm::inverse(centerPose);
+		drawStream.begin(frameAllocator);
+
+		size_t mark = drawStream.size();
+		cursor->record(drawStream, projection, view, game.cursorPosition);
+		cursorCommands = drawStream.since(mark);
+
+		for (int eye = 0; eye < 2; eye++) {
+			const SphereDraws& draws = eyeDraws[eye];
+			if (eye == 1 && draws.transforms == eyeDraws[0].transforms && draws.count == eyeDraws[0].count) {
+				sphereCommands[1] = sphereCommands[0];
+				break;
+			}
+			mark = drawStream.size();
+			if (impostorSpheres)
+				sphereScene->recordImpostors(impostors, drawStream, frameAllocator, draws);
+			else
+				sphereScene->record(drawStream, projection, view, draws);
+			sphereCommands[eye] = drawStream.since(mark);
+		}
+
+		// Score and timer layouts only change when the text does
+		if (game.playing) {
+			textCache->setText(scoreLabel, frameAllocator.format("Score: %d", game.score));
+			textCache->setText(timerLabel, frameAllocator.format("Time: %d", game.secondsLeft));
+		}
+		else {
+			textCache->setText(statusLabel, "Pull the trigger to start");
+		}
+	}
+
+	/* Levels of detail of the spheres and the cursor for this frame, then the draw order regrouped
+	   by level (a stable counting sort, so each level stays front to back) */
+	void groupByLod(const glm::mat4 headPoses[2], const GameSnapshot& game) {
+		unsigned int count = sphereScene->instanceCount;
+		mat4 projections[2], views[2];
+		for (int eye = 0; eye < 2; eye++) {
+			projections[eye] = eyeProjection((ovrEyeType)eye);
+			views[eye] = glm::inverse(headPoses[eye]);
+		}
+		float viewportHeight = (float)eyeViewport(ovrEye_Left).w;
+		sphereScene->selectLods(sphereTransforms, projections, views, viewportHeight, levelsOfDetail);
+		cursor->selectLod(game.cursorPosition, projections, views, viewportHeight, levelsOfDetail);
+
+		const std::vector<uint8_t>& lods = sphereScene->lods;
+		unsigned int start[Mesh::MAX_LODS] = {};
+		std::fill(drawLodEnd, drawLodEnd + Mesh::MAX_LODS, 0u);
+		for (unsigned int i = 0; i < count; i++)
+			drawLodEnd[lods[i]]++;
+		for (int lod = 0; lod < Mesh::MAX_LODS; lod++) {
+			lodInstances[lod] += drawLodEnd[lod];
+			lodTriangles += drawLodEnd[lod] * sphereScene->sphere->triangleCount(lod);
+			start[lod] = lod == 0 ? 0 : drawLodEnd[lod - 1];
+			drawLodEnd[lod] += start[lod];
+		}
+		lodFrames++;
+		if (drawLodEnd[0] == count)
+			return;
+
+		uint32_t* order = frameAllocator.allocate<uint32_t>(count);
+		glm::mat4* transforms = frameAllocator.allocate<glm::mat4>(count);
+		int highlighted = -1;
+		for (unsigned int i = 0; i < count; i++) {
+			unsigned int slot = start[lods[drawOrder[i]]]++;
+			order[slot] = drawOrder[i];
+			transforms[slot] = drawTransforms[i];
+			if ((int)i == drawHighlighted)
+				highlighted = (int)slot;
+		}
+		drawOrder = order;
+		drawTransforms = transforms;
+		drawHighlighted = highlighted;
+	}
+
+	void reportLods() {
+		if (lodFrames == 0)
+			return;
+		printf("Levels of detail: %llu frames, %.0f sphere triangles per frame, spheres per level",
+		       (unsigned long long)lodFrames, (double)lodTriangles / lodFrames);
+		for (int lod = 0; lod < Mesh::MAX_LODS; lod++)
+			printf(lod ? " / %.1f" : " %.1f", (double)lodInstances[lod] / lodFrames);
+		printf(", triangles per level");
+		for (int lod = 0; lod < sphereScene->sphere->lodCount(); lod++)
+			printf(lod ? " / %u" : " %u", (unsigned int)sphereScene->sphere->triangleCount(lod));
+		printf("\n");
+		lodFrames = lodTriangles = 0;
+		std::fill(lodInstances, lodInstances + Mesh::MAX_LODS, 0);
+	}
+
+	/* CPU occlusion culling of the spheres for both eyes, rasterizing and testing spread over the job system */
+	void cullOnCpu(const glm::mat4 headPoses[2]) {
+		auto started = std::chrono::steady_clock::now();
+		unsigned int count = sphereScene->instanceCount;
+		vec3 boundsCenter;
+		float boundsRadius;
+		sphereScene->bounds(boundsCenter, boundsRadius);
+		mat4 toClip[2];
+		for (int eye = 0; eye < 2; eye++)
+			toClip[eye] = eyeProjection((ovrEyeType)eye) * glm::inverse(headPoses[eye]);
+
+		// Occluders: a cube inside each of the spheres nearest the eyes, picked by distance since
+		// the draw order is only nearest first with depth sorting on
+		static const uint32_t CUBE_INDICES[36] = {
+			0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+			2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5 };
+		unsigned int occluders = std::min(OCCLUDER_COUNT, count);
+		vec3 eyeCenter = (vec3(headPoses[0][3]) + vec3(headPoses[1][3])) * 0.5f;
+		float* distances = frameAllocator.allocate<float>(count);
+		uint32_t* nearest = frameAllocator.allocate<uint32_t>(count);
+		for (unsigned int i = 0; i < count; i++) {
+			vec3 offset = vec3(drawTransforms[i] * vec4(boundsCenter, 1.0f)) - eyeCenter;
+			distances[i] = glm::dot(offset, offset);
+			nearest[i] = i;
+		}
+		std::nth_element(nearest, nearest + occluders, nearest + count,
+		                 [&](uint32_t a, uint32_t b) { return distances[a] < distances[b]; });
+		float half = boundsRadius * OCCLUDER_SIZE;
+		uint32_t* indices = frameAllocator.allocate<uint32_t>(occluders * 36);
+		for (unsigned int o = 0; o < occluders; o++)
+			for (int i = 0; i < 36; i++)
+				indices[o * 36 + i] = o * 8 + CUBE_INDICES[i];
+		for (int eye = 0; eye < 2; eye++) {
+			vec4* corners = frameAllocator.allocate<vec4>(occluders * 8);
+			for (unsigned int o = 0; o < occluders; o++) {
+				mat4 toEye = toClip[eye] * drawTransforms[nearest[o]];
+				for (int c = 0; c < 8; c++)
+					corners[o * 8 + c] = toEye * vec4(boundsCenter + half * vec3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f), 1.0f);
+			}
+			softwareOcclusion[eye].setOccluders(corners, indices, occluders * 12);
+		}
+
+		// Tile rows of both eyes' buffers, then the boxes around every sphere for both eyes
+		JobSystem& jobs = JobSystem::instance();
+		unsigned int rows = softwareOcclusion[0].tileRows();
+		unsigned int allRows = rows + softwareOcclusion[1].tileRows();
+		jobs.parallelFor(allRows, 2, [&](size_t begin, size_t end) {
+			if (begin < rows)
+				softwareOcclusion[0].rasterize((unsigned int)begin, (unsigned int)std::min<size_t>(end, rows));
+			if (end > rows)
+				softwareOcclusion[1].rasterize((unsigned int)(std::max<size_t>(begin, rows) - rows), (unsigned int)(end - rows));
+		});
+		uint8_t* visible = frameAllocator.allocate<uint8_t>(count * 2);
+		jobs.parallelFor(count * 2, 16, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				int eye = i < count ? 0 : 1;
+				const mat4& toWorld = drawTransforms[i % count];
+				vec3 center = vec3(toWorld * vec4(boundsCenter, 1.0f));
+				float radius = boundsRadius * std::max(glm::length(vec3(toWorld[0])), std::max(glm::length(vec3(toWorld[1])), glm::length(vec3(toWorld[2]))));
+				visible[i] = softwareOcclusion[eye].test(toClip[eye], center - vec3(radius), center + vec3(radius)) == SoftwareOcclusion::VISIBLE;
+			}
+		});
+
+		// What's left for each eye, still in draw order
+		for (int eye = 0; eye < 2; eye++) {
+			SphereDraws& draws = eyeDraws[eye];
+			draws.transforms = frameAllocator.allocate<glm::mat4>(count);
+			draws.order = frameAllocator.allocate<uint32_t>(count);
+			draws.count = 0;
+			draws.highlighted = -1;
+			int lod = 0;
+			for (unsigned int i = 0; i < count; i++) {
+				for (; i == drawLodEnd[lod] && lod + 1 < Mesh::MAX_LODS; lod++)
+					draws.lodEnd[lod] = draws.count;
+				if (!visible[eye * count + i])
+					continue;
+				if ((int)i == drawHighlighted)
+					draws.highlighted = (int)draws.count;
+				draws.transforms[draws.count] = drawTransforms[i];
+				draws.order[draws.count] = drawOrder[i];
+				draws.count++;
+			}
+			for (; lod < Mesh::MAX_LODS; lod++)
+				draws.lodEnd[lod] = draws.count;
+			softwareCulled += count - draws.count;
+		}
+		softwareTested += count * 2;
+		softwareFrames++;
+		softwareMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+	}
 
-		
+	void reportSoftwareOcclusion() {
+		if (softwareFrames == 0)
+			return;
+		printf("CPU occlusion (%s): %llu frames, %.1f%% of %llu sphere draws culled, %.3f ms per frame\n",
+		       softwareOcclusion[0].usesAvx2() ? "AVX2" : "scalar", (unsigned long long)softwareFrames,
+		       100.0 * softwareCulled / softwareTested, (unsigned long long)softwareTested, softwareMilliseconds / softwareFrames);
+		softwareFrames = softwareTested = softwareCulled = 0;
+		softwareMilliseconds = 0.0;
 	}
 
 	void shutdownGl() override {
+		// Last results of the sphere pass, then release the scene while the context is still there, RiftApp deletes it all
+		glFinish();
+		spherePass.collect();
+		spherePass.report(std::cout, SPHERE_PASS_VARIANTS, SPHERE_PASS_BASELINE);
+		spherePass.release();
+		hiZPass.collect();
+		hiZPass.report(std::cout, HIZ_PASS_VARIANTS);
+		hiZPass.release();
+		culler.release();
+		impostors.release();
+		reportSoftwareOcclusion();
+		reportLods();
+		textCache.reset();
+		text.reset();
+		cursor.reset();
+		scenes.clear();
+		sphereScene = nullptr;
+		RiftApp::shutdownGl();
+		input.stop();
+		input.report(std::cout);
+
+		// Dump whatever is still alive so leaks and waste are visible
+		ResourceRegistry::instance().report(std::cout);
+		StreamBuffer::instance().report(std::cout);
 	}
-		
 
-	void renderScene(const glm::mat4& projection, const glm::mat4& headPose) override {
+	void onKey(int key, int scancode, int action, int mods) override {
+		// N : reload the sphere scene in the background, the current one keeps rendering
+		if (GLFW_PRESS == action && GLFW_KEY_N == key) {
+			sceneReloadRequested = true;
+			return;
+		}
+		// O : report the sphere pass so far and switch between front-to-back and grid order
+		if (GLFW_PRESS == action && GLFW_KEY_O == key) {
+			depthSortToggleRequested = true;
+			return;
+		}
+		// C : report the sphere pass so far and switch occlusion culling off or on
+		if (GLFW_PRESS == action && GLFW_KEY_C == key) {
+			cullingToggleRequested = true;
+			return;
+		}
+		// V : the same for the CPU occlusion culling
+		if (GLFW_PRESS == action && GLFW_KEY_V == key) {
+			softwareCullingToggleRequested = true;
+			return;
+		}
+		// I : report the sphere pass so far and switch between sphere meshes and impostors
+		if (GLFW_PRESS == action && GLFW_KEY_I == key) {
+			impostorToggleRequested = true;
+			return;
+		}
+		// L : report triangles drawn so far and switch levels of detail off or on
+		if (GLFW_PRESS == action && GLFW_KEY_L == key) {
+			lodToggleRequested = true;
+			return;
+		}
+		RiftApp::onKey(key, scancode, action, mods);
+	}
+
+	/* Game logic, on the main thread: tracking, input, timer and score, published as a snapshot */
+	void update() override {
 		// Hand Tracking
 		displayMidpointSeconds = ovr_GetPredictedDisplayTime(_session, 0);
 		trackState = ovr_GetTrackingState(_session, displayMidpointSeconds, ovrTrue);
@@ -803,74 +1616,48 @@ protected:
 		// Hand Tracking Message : Right Hand
 		//cerr << "right hand position = " << handPosition[ovrHand_Right].x << ", " << handPosition[ovrHand_Right].y << ", " << handPosition[ovrHand_Right].z << endl;
 
-
-		// Render Cursor
-		cursor->render(projection, glm::inverse(headPose), vec3(handPosition[ovrHand_Right].x, handPosition[ovrHand_Right].y, handPosition[ovrHand_Right].z));
-
 	
 		/* EXTRA CREDIT: Support grabbing the set of spheres with the controller in the non-dominant hand: pressing and holding a button on the controller grabs the entire 
 		set of spheres as if they're all invisibly connected rigidly to the user's hand (they need to both translate and rotate with the hand). Once the button is released 
 		the movement of the spheres stops*/
-		glm::mat4 LHOrientationPosition;
-		if (OVR_SUCCESS(ovr_GetInputState(_session, ovrControllerType_Touch, &inputState))) {
-			if (inputState.Buttons & ovrButton_X) {
-				// Translation
-				glm::mat4 translate = glm::translate(glm::mat4(1.0f), vec3(handPosition[ovrHand_Left].x, handPosition[ovrHand_Left].y, handPosition[ovrHand_Left].z));
-
-				// Rotation
-				float x = handRotation[ovrHand_Left].x;
-				float y = handRotation[ovrHand_Left].y;
-				float z = handRotation[ovrHand_Left].z;
-				float w = handRotation[ovrHand_Left].w;
-				// Quaternion to Rotation Matrix
-				glm::mat4 rotate = glm::mat4(1 - 2 * y*y - 2 * z*z, 2 * x*y + 2 * w*z, 2 * x*z - 2 * w*y, 0.0f,
-					2 * x*y - 2 * w*z, 1 - 2 * x*x - 2 * z*z, 2 * y*z + 2 * w*x, 0.0f,
-					2 * x*z + 2 * w*y, 2 * y*z - 2 * w*x, 1 - 2 * x*x - 2 * y*y, 0.0f,
-					0.0f, 0.0f, 0.0f, 1.0f);
-				// Left-Hand orientation and position
-				LHOrientationPosition = translate * rotate;
+		// Controller state comes from the input thread (or one sample right here without it)
+		if (!input.running())
+			input.sample();
+		bool grabbing = (input.buttons() & ovrButton_X) != 0;
+		glm::mat4 LHOrientationPosition = grabbing ? grabTransform(handPoses[ovrHand_Left]) : glm::mat4(1.0f);
+
+		// Trigger touches since the last frame, each with the hands where they were at that moment,
+		// so a tap shorter than a frame still starts the game or hits the sphere it was on
+		InputSampler::Event event;
+		while (input.poll(event)) {
+			if (event.type != InputSampler::Event::TOUCHED || event.mask != ovrTouch_RIndexTrigger)
+				continue;
+			if (GameState == false) {
+				// User pulls the trigger button (index finger) to start the game. 
+				startGame();
+				continue;
 			}
-			else {
-				LHOrientationPosition = glm::mat4(1.0f);
-			}
-
+			glm::mat4 spheresAtEvent = grabbing ? grabTransform(event.handPoses[ovrHand_Left]) : glm::mat4(1.0f);
+			if (distanceToHighlighted(spheresAtEvent, event.handPoses[ovrHand_Right].Position) < 0.055f)
+				collider = true;
 		}
-		
 
-		// User pulls the trigger button (index finger) to start the game. 
-		if (OVR_SUCCESS(ovr_GetInputState(_session, ovrControllerType_Touch, &inputState)) && GameState == false)
+		// A trigger still held works as before
+		bool triggerTouched = (input.touches() & ovrTouch_RIndexTrigger) != 0;
+		if (triggerTouched && GameState == false)
 		{
-			if (inputState.Touches & ovrTouch_RIndexTrigger)
-			{
-				GameState = true;
-				// Timer starts
-				start = std::clock();
-				std::cout << "********* GAME START *********" << '\n';
-				// Move the highlight to a new randomly selected sphere
-				random_Highlight();
-				// Count Scores
-				score = 0;
-			}
-		
+			startGame();
 		}
 
 		// If Game is On
 		if (GameState) {
 			// A center-distance test between highlighted sphere and cursor sphere
-
-			vec3 pos = sphereScene->spheres_positions[selectedSphere];
-
-			pos = glm::vec3(LHOrientationPosition * glm::vec4(pos, 1.0f));
-			float dist = sqrt((pos.x - handPosition[ovrHand_Right].x)*(pos.x - handPosition[ovrHand_Right].x) +
-				(pos.y - handPosition[ovrHand_Right].y)*(pos.y - handPosition[ovrHand_Right].y) +
-				(pos.z - handPosition[ovrHand_Right].z)*(pos.z - handPosition[ovrHand_Right].z));
+			float dist = distanceToHighlighted(LHOrientationPosition, handPosition[ovrHand_Right]);
 
 			/* Move the cursor sphere to the highlighted sphere and upon trigger button click on the controller (index finger) test to see if the cursor is touching 
 			the highlighted sphere*/
-			if (OVR_SUCCESS(ovr_GetInputState(_session, ovrControllerType_Touch, &inputState))) {
-				if (dist < 0.055f && inputState.Touches & ovrTouch_RIndexTrigger) {
-					collider = true;
-				}
+			if (dist < 0.055f && triggerTouched) {
+				collider = true;
 			}
 
 			// Time Duration : Each Game for one miniute
@@ -879,8 +1666,8 @@ protected:
 			if (duration >= 60) {
 
 				// Game Message
-				std::cout << "********* GAME OVER *********" << '\n';
-				std::cout << "Your Final Score is " << score << '\n';
+				printf("********* GAME OVER *********\n");
+				printf("Your Final Score is %d\n", score);
 
 				// Reset 
 				GameState = false;
@@ -889,40 +1676,108 @@ protected:
 				score = 0;
 			}
 		}
-		
-
-		// Render Spheres Scene
-		for (unsigned int i = 0; i < NUM_SPHERES; i++) {
-			
-			// If Game State is On
-			if (GameState) {
-				if (i == selectedSphere) {
-					// Once the highlighted sphere has been clicked on, move the highlight to a new randomly selected sphere
-					if (collider) {
-						sphereScene->unhighlight();
-						random_Highlight();
-						// Collide Message
-						score++;
-						std::cout << "Collide! Your Current Score is " << score << '\n';
-					}
-					else {
-						sphereScene->highlight();
-					}
-				}
-				else {
-					sphereScene->unhighlight();
-				}
-			}
-			// Render Sphere
-			
-			//sphereScene->render(projection * glm::translate(glm::mat4(1.0f), vec3(handPosition[ovrHand_Left].x, handPosition[ovrHand_Left].y, handPosition[ovrHand_Left].z)), glm::inverse(headPose), i);
-			sphereScene->render(projection, glm::inverse(headPose), i, LHOrientationPosition);
+
+		// Once the highlighted sphere has been clicked on, move the highlight to a new randomly selected sphere
+		if (GameState && collider) {
+			random_Highlight();
+			// Collide Message
+			score++;
+			printf("Collide! Your Current Score is %d\n", score);
 		}
 
+		// Hand the result to the render thread
+		GameSnapshot& game = snapshots.write();
+		game.cursorPosition = vec3(handPosition[ovrHand_Right].x, handPosition[ovrHand_Right].y, handPosition[ovrHand_Right].z);
+		game.spheresToWorld = LHOrientationPosition;
+		game.playing = GameState;
+		game.highlighted = GameState ? selectedSphere : -1;
+		game.score = score;
+		game.secondsLeft = std::max(0, 60 - (int)duration);
+		snapshots.publish();
+	}
+
+	/* Rendering only, from the snapshot beginRender picked up */
+	void renderScene(const glm::mat4& projection, const glm::mat4& headPose) override {
+		const GameSnapshot& game = snapshots.read();
+
+		// Render Cursor, replayed from recordDraws like the spheres
+		drawStream.replay(cursorCommands);
+
+		// Render Spheres Scene, instanced: the highlighted sphere (if the game is on) gets the highlight shader
+		// (what the CPU occlusion test left of them for this eye)
+		const SphereDraws& draws = eyeDraws[currentEye()];
+		const DrawStream::Range& spheres = sphereCommands[currentEye()];
+		int variant = spherePassVariant();
+		spherePass.begin(variant);
+		if ((variant & 2) == 0) {
+			drawStream.replay(spheres);
+			spherePass.end();
+		}
+		else {
+			// Spheres seen last frame, a depth pyramid of them, the ones that turned visible
+			ivec4 eyeRect = eyeViewport(currentEye());
+			culler.beginEye(currentEye(), draws.order, draws.count);
+			culler.replay(drawStream, spheres, HiZCuller::VISIBLE_LAST_FRAME);
+			spherePass.end();
+
+			hiZPass.begin(0);
+			vec3 boundsCenter;
+			float boundsRadius;
+			sphereScene->bounds(boundsCenter, boundsRadius);
+			culler.buildPyramid(eyeDepthTexture(), eyeFramebuffer(), eyeRect);
+			culler.test(draws.transforms, boundsCenter, boundsRadius, eyeRect);
+			hiZPass.end();
+
+			spherePass.begin(variant, true);
+			culler.replay(drawStream, spheres, HiZCuller::NEWLY_VISIBLE);
+			spherePass.end();
+		}
 
-		//
 
-		
+		// Render Score and Timer above the spheres, laid out by recordDraws
+		glm::mat4 textToClip = projection * glm::inverse(headPose);
+		vec3 textColor(0.0100f, 0.0100f, 0.0732f);   // (0.1, 0.1, 0.3) in sRGB
+		if (game.playing) {
+			textCache->draw(scoreLabel, textToClip * glm::translate(glm::mat4(1.0f), vec3(0.0f, 0.68f, 0.0f)), textColor);
+			textCache->draw(timerLabel, textToClip * glm::translate(glm::mat4(1.0f), vec3(0.32f, 0.68f, 0.0f)), textColor);
+		}
+		else {
+			textCache->draw(statusLabel, textToClip * glm::translate(glm::mat4(1.0f), vec3(0.0f, 0.68f, 0.0f)), textColor);
+		}
+	}
+
+	// Timer starts, score from zero and a first sphere to hit
+	void startGame() {
+		GameState = true;
+		start = std::clock();
+		printf("********* GAME START *********\n");
+		random_Highlight();
+		score = 0;
+	}
+
+	// Transform the left hand applies to the grabbed set of spheres
+	static glm::mat4 grabTransform(const ovrPosef& leftHand) {
+		// Translation
+		glm::mat4 translate = glm::translate(glm::mat4(1.0f), vec3(leftHand.Position.x, leftHand.Position.y, leftHand.Position.z));
+
+		// Rotation
+		float x = leftHand.Orientation.x;
+		float y = leftHand.Orientation.y;
+		float z = leftHand.Orientation.z;
+		float w = leftHand.Orientation.w;
+		// Quaternion to Rotation Matrix
+		glm::mat4 rotate = glm::mat4(1 - 2 * y*y - 2 * z*z, 2 * x*y + 2 * w*z, 2 * x*z - 2 * w*y, 0.0f,
+			2 * x*y - 2 * w*z, 1 - 2 * x*x - 2 * z*z, 2 * y*z + 2 * w*x, 0.0f,
+			2 * x*z + 2 * w*y, 2 * y*z - 2 * w*x, 1 - 2 * x*x - 2 * y*y, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+		// Left-Hand orientation and position
+		return translate * rotate;
+	}
+
+	// Distance from the right hand to the center of the highlighted sphere
+	float distanceToHighlighted(const glm::mat4& spheresToWorld, const ovrVector3f& hand) const {
+		vec3 pos = vec3(spheresToWorld * glm::vec4(ColorSphereScene::gridPosition(selectedSphere), 1.0f));
+		return glm::length(pos - vec3(hand.x, hand.y, hand.z));
 	}
 
 	// Move the highlight to a new randomly selected sphere
@@ -955,7 +1810,26 @@ int main(int argc, char** argv) {
   if (!OVR_SUCCESS(ovr_Initialize(nullptr))) {
     FAIL("Failed to initialize the Oculus SDK");
   }
-  result = ExampleApp().run();
+  // --single-thread renders on the main thread, --render-cpu N pins the render thread,
+  // --render-priority raises its scheduling priority (compare the frame time reports),
+  // --input-rate HZ sets how often the controllers are sampled (0: once per frame)
+  ExampleApp app;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--single-thread") {
+      app.renderThreadOptions.enabled = false;
+    }
+    else if (arg == "--render-cpu" && i + 1 < argc) {
+      app.renderThreadOptions.cpu = atoi(argv[++i]);
+    }
+    else if (arg == "--render-priority") {
+      app.renderThreadOptions.raisePriority = true;
+    }
+    else if (arg == "--input-rate" && i + 1 < argc) {
+      app.inputRate = atof(argv[++i]);
+    }
+  }
+  result = app.run();
 
   //ovr_Shutdown();
   return result;
@@ -15,43 +15,66 @@ using namespace std;
 #include <GLFW/glfw3.h>
 
 #include "shader.h"
+#include "ResourceRegistry.h"
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+	ShaderSources Sources = ReadShaders(vertex_file_path, fragment_file_path);
+	if(!Sources.ok){
+		printf("The current working directory is:");
+#ifdef _WIN32
+		system("CD");
+#else
+		system("pwd");
+#endif
+		getchar();
+		return 0;
+	}
+	return CompileShaders(Sources);
+}
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+ShaderSources ReadShaders(const char * vertex_file_path,const char * fragment_file_path){
+	ShaderSources Sources;
+	Sources.vertexPath = vertex_file_path;
+	Sources.fragmentPath = fragment_file_path;
+	Sources.ok = false;
 
 	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
 	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
 	if(VertexShaderStream.is_open()){
 		std::string Line = "";
 		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
+			Sources.vertexCode += "\n" + Line;
 		VertexShaderStream.close();
 	}else{
 		printf("Impossible to open %s. Check to make sure the file exists and you passed in the right filepath!\n", vertex_file_path);
-		printf("The current working directory is:");
-#ifdef _WIN32
-		system("CD");
-#else
-		system("pwd");
-#endif
-		getchar();
-		return 0;
+		return Sources;
 	}
 
 	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
 	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
 	if(FragmentShaderStream.is_open()){
 		std::string Line = "";
 		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
+			Sources.fragmentCode += "\n" + Line;
 		FragmentShaderStream.close();
 	}
 
+	Sources.ok = true;
+	return Sources;
+}
+
+GLuint CompileShaders(const ShaderSources& Sources){
+	if(!Sources.ok)
+		return 0;
+	const char * vertex_file_path = Sources.vertexPath.c_str();
+	const char * fragment_file_path = Sources.fragmentPath.c_str();
+	const std::string& VertexShaderCode = Sources.vertexCode;
+	const std::string& FragmentShaderCode = Sources.fragmentCode;
+
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
@@ -117,5 +140,105 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
+	// GLSL 410 can't pick block bindings itself, hook the shared blocks up here
+	GLuint CameraBlock = glGetUniformBlockIndex(ProgramID, "Camera");
+	if (CameraBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(ProgramID, CameraBlock, CAMERA_BLOCK_BINDING);
+
+	// the linked binary is the closest thing we have to a program's size
+	GLint BinaryLength = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &BinaryLength);
+	ResourceRegistry::instance().track(ResourceKind::Program, ProgramID, BinaryLength,
+	                                   std::string(vertex_file_path) + " + " + fragment_file_path);
+
+	return ProgramID;
+}
+
+// compiles one stage of a transform feedback program, the log goes to stdout; 0 if it doesn't compile
+static GLuint CompileFeedbackStage(GLenum type, const char * file_path, const std::string& code){
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	printf("Compiling shader : %s\n", file_path);
+	GLuint ShaderID = glCreateShader(type);
+	char const * SourcePointer = code.c_str();
+	glShaderSource(ShaderID, 1, &SourcePointer , NULL);
+	glCompileShader(ShaderID);
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s\n", &ShaderErrorMessage[0]);
+	}
+	if (Result != GL_TRUE){
+		glDeleteShader(ShaderID);
+		return 0;
+	}
+	return ShaderID;
+}
+
+GLuint LoadFeedbackShader(const char * vertex_file_path,const char * varying){
+	return LoadFeedbackShader(vertex_file_path, NULL, &varying, 1);
+}
+
+GLuint LoadFeedbackShader(const char * vertex_file_path,const char * geometry_file_path,const char * const * varyings,int varyingCount){
+	// ReadShaders reads a single file into vertexCode, whatever its stage
+	ShaderSources Sources = ReadShaders(vertex_file_path, "");
+	if(!Sources.ok)
+		return 0;
+	ShaderSources GeometrySources;
+	GeometrySources.ok = true;
+	if(geometry_file_path){
+		GeometrySources = ReadShaders(geometry_file_path, "");
+		if(!GeometrySources.ok)
+			return 0;
+	}
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	GLuint VertexShaderID = CompileFeedbackStage(GL_VERTEX_SHADER, vertex_file_path, Sources.vertexCode);
+	GLuint GeometryShaderID = geometry_file_path ? CompileFeedbackStage(GL_GEOMETRY_SHADER, geometry_file_path, GeometrySources.vertexCode) : 0;
+	if (!VertexShaderID || (geometry_file_path && !GeometryShaderID)){
+		glDeleteShader(VertexShaderID);
+		glDeleteShader(GeometryShaderID);
+		return 0;
+	}
+
+	// Link the program, the captured varyings have to be named before linking
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, VertexShaderID);
+	if (GeometryShaderID)
+		glAttachShader(ProgramID, GeometryShaderID);
+	glTransformFeedbackVaryings(ProgramID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(ProgramID);
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		printf("%s\n", &ProgramErrorMessage[0]);
+	}
+	glDetachShader(ProgramID, VertexShaderID);
+	glDeleteShader(VertexShaderID);
+	if (GeometryShaderID){
+		glDetachShader(ProgramID, GeometryShaderID);
+		glDeleteShader(GeometryShaderID);
+	}
+	if (Result != GL_TRUE){
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+
+	GLuint CameraBlock = glGetUniformBlockIndex(ProgramID, "Camera");
+	if (CameraBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(ProgramID, CameraBlock, CAMERA_BLOCK_BINDING);
+
+	GLint BinaryLength = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &BinaryLength);
+	ResourceRegistry::instance().track(ResourceKind::Program, ProgramID, BinaryLength,
+	                                   std::string(vertex_file_path) + (geometry_file_path ? std::string(" + ") + geometry_file_path : std::string()) +
+	                                   " (transform feedback)");
 	return ProgramID;
 }
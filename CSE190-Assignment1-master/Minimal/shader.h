@@ -1,6 +1,29 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <string>
+
+// uniform block binding of the Camera block (std140 { mat4 projection; mat4 view; }),
+// LoadShaders points every program that declares it here
+const GLuint CAMERA_BLOCK_BINDING = 0;
+
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// LoadShaders in two steps: reading needs no GL context and can
+// run on a loading thread, compiling and linking has to happen on the GL thread
+struct ShaderSources {
+	std::string vertexPath, fragmentPath;
+	std::string vertexCode, fragmentCode;
+	bool ok;   // false if the vertex shader couldn't be read
+};
+ShaderSources ReadShaders(const char * vertex_file_path,const char * fragment_file_path);
+GLuint CompileShaders(const ShaderSources& sources);
+
+// a program of just a vertex shader whose output varying is captured with transform feedback,
+// for work done one point at a time with the rasterizer off; 0 if it doesn't build
+GLuint LoadFeedbackShader(const char * vertex_file_path,const char * varying);
+// the same with varyingCount interleaved varyings and, unless geometry_file_path is NULL, a
+// geometry shader in between that decides which points are captured at all
+GLuint LoadFeedbackShader(const char * vertex_file_path,const char * geometry_file_path,const char * const * varyings,int varyingCount);
+
 #endif
@@ -8,10 +8,14 @@
 
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
+// per instance, a model drawn once still has one instance
+layout (location = 6) in mat4 toWorld;
 
-// Uniform variables can be updated by fetching their location and passing values to that location
-uniform mat4 projection;
-uniform mat4 modelview;
+// the eye being rendered, filled once per eye from the stream buffer
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
 
 // Outputs of the vertex shader are the inputs of the same name of the fragment shader.
 // The default output, gl_Position, should be assigned something. You can define as many
@@ -21,6 +25,6 @@ out vec3 vertNormal;
 void main()
 {
     // OpenGL maintains the D matrix so you only need to multiply by P, V (aka C inverse), and M
-    gl_Position = projection * modelview * vec4(position.x, position.y, position.z, 1.0);
+    gl_Position = projection * view * toWorld * vec4(position.x, position.y, position.z, 1.0);
 	vertNormal = normal;
 }
@@ -2,12 +2,17 @@
 in vec2 TexCoords;
 out vec4 color;
 
+// The glyph atlas holds signed distance fields: 0.5 is the glyph edge,
+// larger values are inside.
 uniform sampler2D text;
 uniform vec3 textColor;
 
 void main()
 {    
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
+    float dist = texture(text, TexCoords).r;
+    // Antialias over one screen pixel, whatever size the text ends up at
+    float width = fwidth(dist);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, dist);
+    color = vec4(textColor, alpha);
 }  
 
@@ -10,7 +10,8 @@ out vec4 fragColor;
 
 void main()
 {
-	vec3 color = vec3(0.4, 0.4, 0.8);
+	// (0.4, 0.4, 0.8) in sRGB, the framebuffer encodes what is written here
+	vec3 color = vec3(0.1329, 0.1329, 0.6038);
 	//if (!all(equal(color, abs(color)))) {
     //    color = vec3(1.0) - abs(color);
     //}
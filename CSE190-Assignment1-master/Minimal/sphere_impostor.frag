@@ -0,0 +1,42 @@
+#version 410 core
+
+// Ray casts the sphere of sphere_impostor.vert's quad: pixels whose eye ray misses it are
+// discarded, the others get the depth and normal of the nearer hit.
+
+in vec3 rayDirection;
+flat in vec4 viewSphere;
+
+// flat colour (linear) like shader_unhighlight.frag, or, highlighted, the normal in the model's frame
+// like shader_highlight.frag
+uniform bool highlighted = false;
+uniform mat3 worldToModel = mat3(1.0);
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+out vec4 fragColor;
+
+void main()
+{
+    // |t rayDirection - center| = radius, the smaller t is the side facing the eye
+    vec3 center = viewSphere.xyz;
+    float radius = viewSphere.w;
+    float a = dot(rayDirection, rayDirection);
+    float b = dot(rayDirection, center);
+    float c = dot(center, center) - radius * radius;
+    float discriminant = b * b - a * c;
+    if (discriminant < 0.0)
+        discard;
+    vec3 hit = rayDirection * ((b - sqrt(discriminant)) / a);
+    vec3 normal = (hit - center) / radius;
+
+    // depth of the hit, not of the quad, so spheres intersect each other and the scene correctly
+    vec4 clip = projection * vec4(hit, 1.0);
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * (clip.z / clip.w) + gl_DepthRange.near + gl_DepthRange.far);
+
+    // the view is rigid, its transpose takes the normal back to world space
+    vec3 color = highlighted ? normalize(worldToModel * (transpose(mat3(view)) * normal)) : vec3(0.1329, 0.1329, 0.6038);
+    fragColor = vec4(color, 1.0);
+}
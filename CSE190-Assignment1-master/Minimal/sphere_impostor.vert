@@ -0,0 +1,46 @@
+#version 410 core
+
+// A quad facing the eye around each sphere, four vertices as a triangle strip per instance;
+// sphere_impostor.frag finds where each pixel's eye ray hits the sphere.
+
+// per instance: world space center and radius
+layout (location = 6) in vec4 sphere;
+
+// the eye being rendered, filled once per eye from the stream buffer
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+// view space point on the quad, the eye ray of the pixel goes through it
+out vec3 rayDirection;
+// view space center and radius
+flat out vec4 viewSphere;
+
+void main()
+{
+    // the view is rigid, the radius stays as it is
+    vec3 center = vec3(view * vec4(sphere.xyz, 1.0));
+    float radius = sphere.w;
+    float distance = length(center);
+    viewSphere = vec4(center, radius);
+    rayDirection = center;
+
+    // the eye inside the sphere: outside the clip volume, nothing is rasterized
+    if (distance <= radius * 1.001)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    // the rays touching the sphere form a cone, which crosses the plane through the center
+    // facing the eye in a circle of radius r d / sqrt(d^2 - r^2); the quad is the square around it,
+    // counter-clockwise seen from the eye
+    vec3 forward = center / distance;
+    vec3 right = normalize(cross(forward, abs(forward.y) > 0.99 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0)));
+    vec3 up = cross(right, forward);
+    float halfSize = radius * distance / sqrt(distance * distance - radius * radius);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    rayDirection = center + halfSize * (corner.x * right + corner.y * up);
+    gl_Position = projection * vec4(rayDirection, 1.0);
+}
@@ -0,0 +1,173 @@
+#include "Tests.h"
+#include "AllocationTracker.h"
+#include "DepthSort.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+#include "StreamBuffer.h"
+#include "TextLayoutCache.h"
+#include "TextRenderer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* The pieces of a frame body, the way main.cpp runs them, must not touch the heap once they
+   are warmed up: every piece runs a few frames first, then the same frames again under an
+   alloc::Guard. The GL pieces get a hidden window and are skipped when there is none. */
+namespace
+{
+    const int WARMUP_FRAMES = 8;
+    const int CHECKED_FRAMES = 64;
+    const size_t INSTANCES = 1000;
+    const char* const FONT_PATH = "C:/Windows/Fonts/arial.ttf";
+
+    struct alignas(64) CacheLine {
+        unsigned char bytes[64];
+    };
+
+    // the guard sees plain, array and over-aligned allocations, and none inside an Exempt
+    void guardCounts() {
+        alloc::Guard guard;
+        int* volatile single = new int(1);
+        delete single;
+        char* volatile array = new char[16];
+        delete[] array;
+        uint64_t expected = 2;
+#ifdef __cpp_aligned_new
+        CacheLine* volatile aligned = new CacheLine();
+        delete aligned;
+        expected++;
+#endif
+        {
+            alloc::Exempt exempt;
+            int* volatile exempted = new int(2);
+            delete exempted;
+        }
+        CHECK(guard.allocations() == expected);
+    }
+
+    // frame scratch memory, instance transforms on the job system and the front to back order
+    void frameBody(FrameAllocator& frame, int frameIndex) {
+        frame.beginFrame();
+        glm::mat4* transforms = frame.allocate<glm::mat4>(INSTANCES);
+        JobSystem::instance().parallelFor(INSTANCES, 32, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                glm::vec3 position((float)(i % 10), (float)(i / 10 % 10), (float)(i / 100) + 0.01f * frameIndex);
+                transforms[i] = glm::translate(glm::mat4(1.0f), position);
+            }
+        });
+        uint32_t* order = frame.allocate<uint32_t>(INSTANCES);
+        depthsort::frontToBack(transforms, INSTANCES, glm::vec3(4.5f, 4.5f, -5.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+                               frame, order);
+        frame.format("Score: %d", frameIndex);
+    }
+
+    void cpuFrame() {
+        FrameAllocator frame;
+        for (int i = 0; i < WARMUP_FRAMES; i++)
+            frameBody(frame, i);
+
+        alloc::Guard guard;
+        for (int i = 0; i < CHECKED_FRAMES; i++)
+            frameBody(frame, WARMUP_FRAMES + i);
+        CHECK(guard.allocations() == 0);
+    }
+
+    // a 4.1 core context on a window that is never shown, like the one main.cpp renders with
+    GLFWwindow* createHiddenContext() {
+        if (!glfwInit())
+            return nullptr;
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        GLFWwindow* window = glfwCreateWindow(64, 64, "Tests", nullptr, nullptr);
+        if (!window) {
+            glfwTerminate();
+            return nullptr;
+        }
+        glfwMakeContextCurrent(window);
+        glewExperimental = GL_TRUE;
+        if (glewInit() != GLEW_OK) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return nullptr;
+        }
+        glGetError();
+        return window;
+    }
+
+    // transforms and a uniform block per frame through the stream buffer, cycling its regions
+    void streamFrame(int frameIndex) {
+        StreamBuffer& stream = StreamBuffer::instance();
+        glm::mat4 transforms[16];
+        for (int i = 0; i < 16; i++)
+            transforms[i] = glm::translate(glm::mat4(1.0f), glm::vec3((float)i, (float)frameIndex, 0.0f));
+        stream.beginFrame();
+        stream.push(transforms, sizeof(transforms));
+        stream.bindUniform(0, &transforms[0], sizeof(glm::mat4));
+        stream.endFrame();
+    }
+
+    void streamBuffer() {
+        for (int i = 0; i < WARMUP_FRAMES; i++)
+            streamFrame(i);
+
+        alloc::Guard guard;
+        for (int i = 0; i < CHECKED_FRAMES; i++)
+            streamFrame(WARMUP_FRAMES + i);
+        CHECK(guard.allocations() == 0);
+    }
+
+    // the score label changing every frame, with the text formatted into frame memory
+    void textLayout() {
+        TextRenderer font(FONT_PATH);
+        if (!font.valid())
+            printf("  no font at %s, labels stay empty\n", FONT_PATH);
+        TextLayoutCache cache;
+        int label = cache.createLabel(&font, 0.001f, 32);
+        CHECK(label >= 0);
+
+        // every glyph the checked frames use, until the worker has rasterized them all
+        const char* const GLYPHS = "Score: 0123456789";
+        cache.setText(label, GLYPHS);
+        for (int tries = 0; tries < 200; tries++) {
+            unsigned int before = cache.rebuilds();
+            cache.setText(label, GLYPHS);
+            if (cache.rebuilds() == before)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        FrameAllocator frame;
+        frame.format("Score: %d", 0);
+        unsigned int before = cache.rebuilds();
+        alloc::Guard guard;
+        for (int i = 0; i < CHECKED_FRAMES; i++) {
+            frame.beginFrame();
+            cache.setText(label, frame.format("Score: %d", i));
+        }
+        CHECK(guard.allocations() == 0);
+        CHECK(cache.rebuilds() - before == CHECKED_FRAMES);
+    }
+}
+
+void test::allocations() {
+    guardCounts();
+    cpuFrame();
+
+    GLFWwindow* window = createHiddenContext();
+    if (!window) {
+        printf("  no GL 4.1 context, stream buffer and text layout skipped\n");
+        return;
+    }
+    streamBuffer();
+    textLayout();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
@@ -0,0 +1,107 @@
+#include "Tests.h"
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const int SEGMENTS = 64, RINGS = 32;
+
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec2 texCoords;
+    };
+
+    // a unit sphere the way the importer hands it over with identical vertices joined: the
+    // texture seam column and every pole corner are vertices of their own at a shared position
+    struct Sphere {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+
+        Sphere() {
+            const float pi = 3.14159265f;
+            for (int ring = 0; ring <= RINGS; ring++)
+                for (int segment = 0; segment <= SEGMENTS; segment++) {
+                    float theta = pi * ring / RINGS, phi = 2.0f * pi * segment / SEGMENTS;
+                    Vertex v;
+                    v.position = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                    v.texCoords = glm::vec2((float)segment / SEGMENTS, (float)ring / RINGS);
+                    vertices.push_back(v);
+                }
+            for (int ring = 0; ring < RINGS; ring++)
+                for (int segment = 0; segment < SEGMENTS; segment++) {
+                    unsigned int a = ring * (SEGMENTS + 1) + segment, b = a + 1, c = a + SEGMENTS + 1, d = c + 1;
+                    unsigned int quad[] = { a, c, b, b, c, d };
+                    indices.insert(indices.end(), quad, quad + 6);
+                }
+        }
+
+        size_t simplify(size_t targetIndexCount, std::vector<unsigned int>& out, float& error) const {
+            out.resize(indices.size());
+            size_t count = meshsimplify::simplify(&vertices[0].position, sizeof(Vertex), vertices.size(),
+                                                  indices.data(), indices.size(), targetIndexCount, 0.1f, out.data(), &error);
+            out.resize(count);
+            return count;
+        }
+    };
+
+    // every level has fewer triangles than the one before, and the surface stays within the
+    // error bound: the vertices are all on the sphere, so a triangle's center shows how far in it cuts
+    void levelsShrink(const Sphere& sphere) {
+        size_t previous = sphere.indices.size();
+        for (int lod = 1; lod <= 2; lod++) {
+            std::vector<unsigned int> level;
+            float error = 0.0f;
+            size_t count = sphere.simplify((sphere.indices.size() >> lod) / 3 * 3, level, error);
+            CHECK(count > 0 && count % 3 == 0);
+            CHECK(count * 4 <= previous * 3);
+            CHECK(error > 0.0f && error <= 0.1f);
+            float deepest = 0.0f;
+            for (size_t i = 0; i + 2 < count; i += 3) {
+                glm::vec3 center = (sphere.vertices[level[i]].position + sphere.vertices[level[i + 1]].position +
+                                    sphere.vertices[level[i + 2]].position) / 3.0f;
+                deepest = std::max(deepest, 1.0f - glm::length(center));
+            }
+            CHECK(deepest <= error);
+            previous = count;
+        }
+    }
+
+    // the seam column keeps all of its vertices, so it can't tear open
+    void seamsStay(const Sphere& sphere) {
+        std::vector<unsigned int> level;
+        float error = 0.0f;
+        sphere.simplify(sphere.indices.size() / 4 / 3 * 3, level, error);
+        std::vector<bool> used(sphere.vertices.size(), false);
+        for (unsigned int v : level)
+            used[v] = true;
+        for (int ring = 1; ring < RINGS; ring++) {
+            CHECK(used[ring * (SEGMENTS + 1)]);
+            CHECK(used[ring * (SEGMENTS + 1) + SEGMENTS]);
+        }
+    }
+
+    // without joined vertices every corner is a seam and nothing may move
+    void unjoinedStays(const Sphere& sphere) {
+        Sphere split;
+        split.vertices.clear();
+        split.indices.clear();
+        for (unsigned int v : sphere.indices) {
+            split.indices.push_back((unsigned int)split.vertices.size());
+            split.vertices.push_back(sphere.vertices[v]);
+        }
+        std::vector<unsigned int> level;
+        float error = 1.0f;
+        CHECK(split.simplify(split.indices.size() / 2 / 3 * 3, level, error) == split.indices.size());
+        CHECK(error == 0.0f);
+    }
+}
+
+void test::meshSimplify() {
+    Sphere sphere;
+    levelsShrink(sphere);
+    seamsStay(sphere);
+    unjoinedStays(sphere);
+}
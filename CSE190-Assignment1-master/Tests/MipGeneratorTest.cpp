@@ -0,0 +1,71 @@
+#include "Tests.h"
+#include "MipGenerator.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // the same pseudo random image on every run and every machine
+    std::vector<uint8_t> noise(int width, int height, int channels) {
+        std::vector<uint8_t> pixels((size_t)width * height * channels);
+        uint32_t state = 12345u;
+        for (uint8_t& p : pixels) {
+            state = state * 1664525u + 1013904223u;
+            p = (uint8_t)(state >> 24);
+        }
+        return pixels;
+    }
+
+    // every level of every path against the scalar one, odd sizes so the edge texels are covered
+    void pathsMatchScalar() {
+        static const char* const paths[] = { "SSE2", "AVX2" };
+        static const int sizes[][3] = { { 37, 23, 4 }, { 64, 64, 3 }, { 19, 1, 1 }, { 1, 31, 2 } };
+        for (const auto& size : sizes) {
+            std::vector<uint8_t> pixels = noise(size[0], size[1], size[2]);
+            mip::Image image(pixels.data(), size[0], size[1], size[2]);
+            for (bool srgb : { false, true }) {
+                CHECK(mip::useSimdPath("scalar"));
+                mip::Chain reference = mip::generate(image, srgb, nullptr);
+                for (const char* path : paths) {
+                    if (!mip::useSimdPath(path)) {
+                        printf("  %s not available on this CPU, skipped\n", path);
+                        continue;
+                    }
+                    mip::Chain chain = mip::generate(image, srgb, nullptr);
+                    CHECK(chain.levels.size() == reference.levels.size());
+                    for (size_t level = 0; level < chain.levels.size() && level < reference.levels.size(); level++)
+                        CHECK(chain.levels[level] == reference.levels[level]);
+                }
+            }
+        }
+    }
+
+    // black and white texels average to half the light: 188 encoded as sRGB, 128 as linear
+    void checkerAverages() {
+        static const uint8_t checker[2 * 2 * 4] = {
+            0, 0, 0, 255,        255, 255, 255, 255,
+            255, 255, 255, 255,  0, 0, 0, 255 };
+        mip::Image image(checker, 2, 2, 4);
+        mip::Chain srgb = mip::generate(image, true, nullptr);
+        mip::Chain linear = mip::generate(image, false, nullptr);
+        CHECK(srgb.levels.size() == 2 && linear.levels.size() == 2);
+        for (int c = 0; c < 3; c++) {
+            CHECK(srgb.levels[1][c] == 188);
+            CHECK(linear.levels[1][c] == 128);
+        }
+        // alpha is never sRGB
+        CHECK(srgb.levels[1][3] == 255);
+    }
+}
+
+namespace test
+{
+    void mipGenerator() {
+        const char* detected = mip::simdPath();
+        pathsMatchScalar();
+        checkerAverages();
+        mip::useSimdPath(detected);
+    }
+}
@@ -0,0 +1,114 @@
+#include "Tests.h"
+#include "SoftwareOcclusion.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    const unsigned int WIDTH = 320, HEIGHT = 180;
+
+    // the eye at the origin looking down -z, like a view that hasn't moved
+    glm::mat4 projection() {
+        return glm::perspective(glm::radians(90.0f), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+    }
+
+    // a cube of half size half around center, its faces counter-clockwise seen from outside
+    void addCube(const glm::vec3& center, float half, const glm::mat4& toClip,
+                 std::vector<glm::vec4>& vertices, std::vector<uint32_t>& indices) {
+        static const uint32_t faces[36] = { 0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+                                            2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5 };
+        uint32_t base = (uint32_t)vertices.size();
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner(center.x + ((i & 1) ? half : -half), center.y + ((i & 2) ? half : -half),
+                             center.z + ((i & 4) ? half : -half));
+            vertices.push_back(toClip * glm::vec4(corner, 1.0f));
+        }
+        for (uint32_t index : faces)
+            indices.push_back(base + index);
+    }
+
+    // a big cube straight ahead and a small one up and to the right, further away
+    struct Scene {
+        std::vector<glm::vec4> vertices;
+        std::vector<uint32_t> indices;
+
+        Scene() {
+            addCube(glm::vec3(0.0f, 0.0f, -3.0f), 1.0f, projection(), vertices, indices);
+            addCube(glm::vec3(1.5f, 1.2f, -5.0f), 0.4f, projection(), vertices, indices);
+        }
+
+        void setUp(SoftwareOcclusion& occlusion, bool avx2) const {
+            occlusion.resize(WIDTH, HEIGHT);
+            occlusion.useAvx2(avx2);
+            occlusion.setOccluders(vertices.data(), indices.data(), indices.size() / 3);
+        }
+    };
+
+    void avx2MatchesScalar(const Scene& scene) {
+        if (!SoftwareOcclusion::hasAvx2()) {
+            printf("  AVX2 not available on this CPU, skipped\n");
+            return;
+        }
+        SoftwareOcclusion scalar, avx2;
+        scene.setUp(scalar, false);
+        scene.setUp(avx2, true);
+        CHECK(!scalar.usesAvx2() && avx2.usesAvx2());
+        scalar.rasterize(0, scalar.tileRows());
+        avx2.rasterize(0, avx2.tileRows());
+        CHECK(avx2.sameContents(scalar));
+    }
+
+    void results(const Scene& scene) {
+        glm::mat4 toClip = projection();
+        for (bool avx2 : { false, true }) {
+            SoftwareOcclusion occlusion;
+            scene.setUp(occlusion, avx2);
+            occlusion.rasterize(0, occlusion.tileRows());
+            // in front of the big cube, behind it, beside it, and half hidden behind it
+            CHECK(occlusion.test(toClip, glm::vec3(-0.3f, -0.3f, -1.5f), glm::vec3(0.3f, 0.3f, -1.2f)) == SoftwareOcclusion::VISIBLE);
+            CHECK(occlusion.test(toClip, glm::vec3(-0.3f, -0.3f, -8.0f), glm::vec3(0.3f, 0.3f, -7.0f)) == SoftwareOcclusion::OCCLUDED);
+            CHECK(occlusion.test(toClip, glm::vec3(3.0f, -0.3f, -8.0f), glm::vec3(3.6f, 0.3f, -7.0f)) == SoftwareOcclusion::VISIBLE);
+            CHECK(occlusion.test(toClip, glm::vec3(0.5f, -0.3f, -8.0f), glm::vec3(3.5f, 0.3f, -7.0f)) == SoftwareOcclusion::VISIBLE);
+            // off to the side of the view and beyond the far plane; behind the eye there is no
+            // rectangle to test, so it is let through
+            CHECK(occlusion.test(toClip, glm::vec3(-60.0f, -0.3f, -8.0f), glm::vec3(-50.0f, 0.3f, -7.0f)) == SoftwareOcclusion::OUTSIDE);
+            CHECK(occlusion.test(toClip, glm::vec3(-0.3f, -0.3f, -300.0f), glm::vec3(0.3f, 0.3f, -200.0f)) == SoftwareOcclusion::OUTSIDE);
+            CHECK(occlusion.test(toClip, glm::vec3(-0.3f, -0.3f, 5.0f), glm::vec3(0.3f, 0.3f, 6.0f)) == SoftwareOcclusion::VISIBLE);
+        }
+    }
+
+    // the jobs split the rows differently from frame to frame, the buffer must not care
+    void rowRangesAgree(const Scene& scene) {
+        for (bool avx2 : { false, true }) {
+            SoftwareOcclusion whole;
+            scene.setUp(whole, avx2);
+            unsigned int rows = whole.tileRows();
+            whole.rasterize(0, rows);
+
+            SoftwareOcclusion halves, single;
+            scene.setUp(halves, avx2);
+            scene.setUp(single, avx2);
+            halves.rasterize(rows / 2, rows + 5);
+            halves.rasterize(0, rows / 2);
+            for (unsigned int row = rows; row-- > 0;)
+                single.rasterize(row, row + 1);
+            CHECK(halves.sameContents(whole));
+            CHECK(single.sameContents(whole));
+
+            // rasterizing a range again starts it over rather than adding to it
+            halves.rasterize(3, 7);
+            CHECK(halves.sameContents(whole));
+        }
+    }
+}
+
+void test::softwareOcclusion() {
+    Scene scene;
+    avx2MatchesScalar(scene);
+    results(scene);
+    rowRangesAgree(scene);
+}
@@ -0,0 +1,23 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+/* Tests - checks of the engine modules that need no headset, run by main.cpp. Those that
+   need GL make their own hidden window and skip that part without one. A failed CHECK
+   prints where it failed and the test carries on; the runner exits with the number of
+   failures. */
+namespace test
+{
+    void fail(const char* file, int line, const char* expression);
+    int failures();
+
+    // one per module, in the order the runner calls them
+    void mipGenerator();
+    void allocations();
+    void softwareOcclusion();
+    void meshSimplify();
+}
+
+#define CHECK(expression) \
+    do { if (!(expression)) test::fail(__FILE__, __LINE__, #expression); } while (0)
+
+#endif
@@ -0,0 +1,40 @@
+#include "Tests.h"
+
+#include <cstdio>
+
+namespace
+{
+    int failureCount = 0;
+}
+
+namespace test
+{
+    void fail(const char* file, int line, const char* expression) {
+        printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+        failureCount++;
+    }
+
+    int failures() {
+        return failureCount;
+    }
+}
+
+int main() {
+    struct Test {
+        const char* name;
+        void (*run)();
+    };
+    static const Test tests[] = {
+        { "mip generator", test::mipGenerator },
+        { "steady-state allocations", test::allocations },
+        { "software occlusion", test::softwareOcclusion },
+        { "mesh simplify", test::meshSimplify },
+    };
+    for (const Test& t : tests) {
+        int before = test::failures();
+        t.run();
+        printf("%-28s %s\n", t.name, test::failures() == before ? "ok" : "FAILED");
+    }
+    printf("%d failure(s)\n", test::failures());
+    return test::failures();
+}